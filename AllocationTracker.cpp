@@ -0,0 +1,145 @@
+#include "AllocationTracker.h"
+
+#ifdef ENGINE_ALLOC_TRACKING
+
+#include "Metrics.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Constant initialized, so it already works for allocations made before main
+AllocationTracker allocationTracker;
+
+static thread_local const char* currentTag = NULL;
+static thread_local int frameDepth = 0;
+// Set while reporting, printf may allocate itself
+static thread_local bool reporting = false;
+
+AllocationTagScope::AllocationTagScope(const char* tag) : previous(currentTag)
+{
+    currentTag = tag;
+}
+
+AllocationTagScope::~AllocationTagScope()
+{
+    currentTag = previous;
+}
+
+AllocationFrameScope::AllocationFrameScope()
+{
+    frameDepth++;
+}
+
+AllocationFrameScope::~AllocationFrameScope()
+{
+    frameDepth--;
+}
+
+void AllocationTracker::Record(size_t size)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+
+    // Tags are string literals, so the first free slot is claimed by pointer
+    const char* tag = currentTag != NULL ? currentTag : "untagged";
+    for (int i = 0; i < ALLOCATION_MAX_TAGS; i++) {
+        const char* name = tags[i].name.load(std::memory_order_acquire);
+        if (name == NULL) {
+            const char* expected = NULL;
+            if (tags[i].name.compare_exchange_strong(expected, tag, std::memory_order_acq_rel) == false &&
+                expected != tag) continue;
+        }
+        else if (name != tag) continue;
+
+        tags[i].count.fetch_add(1, std::memory_order_relaxed);
+        tags[i].bytes.fetch_add(size, std::memory_order_relaxed);
+        break;
+    }
+
+    if (frameDepth > 0 && armed.load(std::memory_order_relaxed) && reporting == false) {
+        uint64_t seen = inFrame.fetch_add(1, std::memory_order_relaxed);
+        if (assertInFrame && seen < (uint64_t)reportLimit) {
+            reporting = true;
+            fprintf(stderr, "Allocation of %zu bytes during a frame (%s)\n", size, tag);
+            reporting = false;
+        }
+    }
+}
+
+void AllocationTracker::EndFrame()
+{
+    uint64_t nowCount = count.load(std::memory_order_relaxed);
+    uint64_t nowBytes = bytes.load(std::memory_order_relaxed);
+    metrics.Add(METRIC_ALLOCATIONS, nowCount - lastCount);
+    metrics.Add(METRIC_BYTES_ALLOCATED, nowBytes - lastBytes);
+    lastCount = nowCount;
+    lastBytes = nowBytes;
+
+    if (++frames == warmupFrames) armed.store(true, std::memory_order_relaxed);
+}
+
+void AllocationTracker::Report()
+{
+    reporting = true;
+    printf("Heap allocations: %llu, %llu bytes, %llu frees\n", (unsigned long long)count.load(),
+        (unsigned long long)bytes.load(), (unsigned long long)frees.load());
+    for (int i = 0; i < ALLOCATION_MAX_TAGS; i++) {
+        const char* name = tags[i].name.load();
+        if (name == NULL) break;
+        printf("  %-24s %10llu %14llu bytes\n", name, (unsigned long long)tags[i].count.load(),
+            (unsigned long long)tags[i].bytes.load());
+    }
+    if (armed.load()) {
+        int steady = frames - warmupFrames;
+        printf("Allocations during frames after the first %d: %llu over %d frames\n", warmupFrames,
+            (unsigned long long)inFrame.load(), steady);
+    }
+    reporting = false;
+}
+
+static void* Allocate(size_t size)
+{
+    if (size == 0) size = 1;
+    while (true) {
+        void* memory = malloc(size);
+        if (memory != NULL) {
+            allocationTracker.Record(size);
+            return memory;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == NULL) throw std::bad_alloc();
+        handler();
+    }
+}
+
+static void Free(void* memory)
+{
+    if (memory == NULL) return;
+    allocationTracker.frees.fetch_add(1, std::memory_order_relaxed);
+    free(memory);
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try { return Allocate(size); }
+    catch (...) { return NULL; }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try { return Allocate(size); }
+    catch (...) { return NULL; }
+}
+
+void operator delete(void* memory) noexcept { Free(memory); }
+void operator delete[](void* memory) noexcept { Free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { Free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { Free(memory); }
+void operator delete(void* memory, size_t) noexcept { Free(memory); }
+void operator delete[](void* memory, size_t) noexcept { Free(memory); }
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+// Counts heap allocations made through operator new, per frame and per tag. Only built
+// with ENGINE_ALLOC_TRACKING defined, otherwise new and delete are the standard ones and
+// the macros compile to nothing.
+//
+//   ALLOC_TAG("level streaming");  allocations in the enclosing block count against this tag
+//   ALLOC_FRAME_SCOPE();           the enclosing block is frame work, which should not allocate
+//
+// With assertInFrame set, every allocation inside a frame scope is reported once the
+// warm up frames are over.
+
+#ifdef ENGINE_ALLOC_TRACKING
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ALLOCATION_MAX_TAGS 32
+
+struct AllocationTagCounts {
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+};
+
+class AllocationTracker {
+public:
+
+    // Set before the frame loop starts
+    bool assertInFrame = false;
+    int warmupFrames = 120;
+    // Stops printing after this many, the total is still counted
+    int reportLimit = 20;
+
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<uint64_t> frees{ 0 };
+    // Allocations inside frame scopes after the warm up
+    std::atomic<uint64_t> inFrame{ 0 };
+    std::atomic<bool> armed{ false };
+
+    AllocationTagCounts tags[ALLOCATION_MAX_TAGS];
+
+    void Record(size_t size);
+
+    // Main thread, once per frame. Feeds the frame's counts to metrics.
+    void EndFrame();
+    // Totals per tag and, with assertInFrame, how many allocations a frame made
+    void Report();
+
+private:
+
+    int frames = 0;
+    uint64_t lastCount = 0;
+    uint64_t lastBytes = 0;
+};
+
+extern AllocationTracker allocationTracker;
+
+class AllocationTagScope {
+public:
+    AllocationTagScope(const char* tag);
+    ~AllocationTagScope();
+
+private:
+    const char* previous;
+};
+
+class AllocationFrameScope {
+public:
+    AllocationFrameScope();
+    ~AllocationFrameScope();
+};
+
+#define ALLOC_JOIN2(a, b) a##b
+#define ALLOC_JOIN(a, b) ALLOC_JOIN2(a, b)
+#define ALLOC_TAG(name) AllocationTagScope ALLOC_JOIN(allocationTag, __LINE__)(name)
+#define ALLOC_FRAME_SCOPE() AllocationFrameScope ALLOC_JOIN(allocationFrame, __LINE__)
+
+#else
+
+#define ALLOC_TAG(name) do {} while (0)
+#define ALLOC_FRAME_SCOPE() do {} while (0)
+
+#endif
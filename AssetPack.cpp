@@ -0,0 +1,184 @@
+#include "AssetPack.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+AssetPack assetPack;
+
+// Pack names always use forward slashes
+static std::string NormalizeName(const char* path)
+{
+    std::string name = path;
+    std::replace(name.begin(), name.end(), '\\', '/');
+    while (name.compare(0, 2, "./") == 0) name.erase(0, 2);
+    return name;
+}
+
+bool AssetPack::Open(const char* path)
+{
+    Close();
+    if (file.Open(path) == false) return false;
+
+    header = (const AssetPackHeader*)file.data;
+    bool valid = file.size >= sizeof(AssetPackHeader)
+        && memcmp(header->magic, "APAK", 4) == 0
+        && header->version == ASSET_PACK_VERSION
+        && header->entryCount <= (file.size - sizeof(AssetPackHeader)) / sizeof(AssetPackEntry);
+
+    // Written as subtractions so a corrupt offset can't wrap past the check. Find
+    // binary searches on the name hash, an unsorted table would just miss.
+    if (valid) {
+        entries = (const AssetPackEntry*)(file.data + sizeof(AssetPackHeader));
+        for (uint32_t i = 0; i < header->entryCount && valid; i++) {
+            const AssetPackEntry& entry = entries[i];
+            valid = entry.offset <= file.size && entry.size <= file.size - entry.offset
+                && entry.nameOffset <= file.size && entry.nameLength <= file.size - entry.nameOffset
+                && (i == 0 || entries[i - 1].nameHash <= entry.nameHash);
+        }
+    }
+
+    if (valid == false) {
+        printf("Ignoring invalid asset pack %s\n", path);
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void AssetPack::Close()
+{
+    file.Close();
+    header = NULL;
+    entries = NULL;
+}
+
+bool AssetPack::Find(const char* name, const unsigned char** data, size_t* size)
+{
+    if (IsOpen() == false) return false;
+
+    std::string normalized = NormalizeName(name);
+    uint64_t nameHash = HashBytes(normalized.data(), normalized.size());
+
+    const AssetPackEntry* end = entries + header->entryCount;
+    const AssetPackEntry* entry = std::lower_bound(entries, end, nameHash,
+        [](const AssetPackEntry& e, uint64_t hash) { return e.nameHash < hash; });
+
+    for (; entry != end && entry->nameHash == nameHash; entry++) {
+        if (entry->nameLength != normalized.size()) continue;
+        if (memcmp(file.data + entry->nameOffset, normalized.data(), normalized.size()) != 0) continue;
+
+        if (verifyHashes && HashBytes(file.data + entry->offset, (size_t)entry->size) != entry->contentHash) {
+            printf("Asset %s is corrupt in the pack\n", normalized.c_str());
+            return false;
+        }
+        *data = file.data + entry->offset;
+        *size = (size_t)entry->size;
+        return true;
+    }
+    return false;
+}
+
+static bool ReadLooseFile(const char* path, std::vector<unsigned char>* bytes)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    bool ok = size >= 0;
+    if (ok) {
+        bytes->resize(size);
+        ok = fread(bytes->data(), 1, size, file) == (size_t)size;
+    }
+    fclose(file);
+    return ok;
+}
+
+bool ReadAsset(const char* path, AssetData* asset)
+{
+    asset->owned.clear();
+    if (assetPack.Find(path, &asset->data, &asset->size)) return true;
+
+    if (ReadLooseFile(path, &asset->owned) == false) {
+        asset->data = NULL;
+        asset->size = 0;
+        return false;
+    }
+    asset->data = asset->owned.data();
+    asset->size = asset->owned.size();
+    return true;
+}
+
+int PackAssets(int argc, char* argv[])
+{
+    if (argc < 2) {
+        printf("usage: --pack-assets out.pak file...\n");
+        return 1;
+    }
+
+    struct Source {
+        std::string name;
+        std::vector<unsigned char> bytes;
+        AssetPackEntry entry;
+    };
+    std::vector<Source> sources(argc - 1);
+
+    for (int i = 1; i < argc; i++) {
+        Source& source = sources[i - 1];
+        source.name = NormalizeName(argv[i]);
+        if (ReadLooseFile(argv[i], &source.bytes) == false) {
+            printf("%s: unable to read\n", argv[i]);
+            return 1;
+        }
+        source.entry.nameHash = HashBytes(source.name.data(), source.name.size());
+        source.entry.contentHash = HashBytes(source.bytes.data(), source.bytes.size());
+        source.entry.size = source.bytes.size();
+        source.entry.nameLength = (uint32_t)source.name.size();
+    }
+
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) {
+        return a.entry.nameHash != b.entry.nameHash ? a.entry.nameHash < b.entry.nameHash : a.name < b.name;
+    });
+
+    size_t offset = sizeof(AssetPackHeader) + sources.size() * sizeof(AssetPackEntry);
+    for (Source& source : sources) {
+        source.entry.nameOffset = (uint32_t)offset;
+        offset += source.name.size();
+    }
+    for (Source& source : sources) {
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        source.entry.offset = offset;
+        offset += source.bytes.size();
+    }
+
+    std::vector<unsigned char> pack(offset, 0);
+    AssetPackHeader header;
+    memcpy(header.magic, "APAK", 4);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t)sources.size();
+    header.reserved = 0;
+    memcpy(pack.data(), &header, sizeof(header));
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        const Source& source = sources[i];
+        memcpy(pack.data() + sizeof(AssetPackHeader) + i * sizeof(AssetPackEntry), &source.entry, sizeof(AssetPackEntry));
+        memcpy(pack.data() + source.entry.nameOffset, source.name.data(), source.name.size());
+        memcpy(pack.data() + source.entry.offset, source.bytes.data(), source.bytes.size());
+    }
+
+    FILE* out = fopen(argv[0], "wb");
+    if (out == NULL || fwrite(pack.data(), 1, pack.size(), out) != pack.size()) {
+        printf("%s: unable to write\n", argv[0]);
+        if (out != NULL) fclose(out);
+        return 1;
+    }
+    fclose(out);
+
+    printf("%s: %d assets, %d bytes\n", argv[0], (int)sources.size(), (int)pack.size());
+    return 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Pack layout: header, entry table sorted by name hash, name strings, then the
+// file contents, each starting at an ASSET_PACK_ALIGNMENT boundary.
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 64
+#define ASSET_PACK_DEFAULT_NAME "assets.pak"
+
+struct AssetPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct AssetPackEntry {
+    uint64_t nameHash;
+    uint64_t contentHash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+// Bytes of one asset. Points straight into the mapped pack when the asset
+// came from there, otherwise owns a copy read from the loose file.
+struct AssetData {
+    const unsigned char* data = NULL;
+    size_t size = 0;
+    std::vector<unsigned char> owned;
+
+    AssetData() {}
+    // Moving keeps the vector's buffer, so data stays valid. A copy would not.
+    AssetData(AssetData&&) = default;
+    AssetData& operator=(AssetData&&) = default;
+    AssetData(const AssetData&) = delete;
+    AssetData& operator=(const AssetData&) = delete;
+};
+
+class AssetPack {
+public:
+
+    bool verifyHashes = false;
+
+    bool Open(const char* path);
+    void Close();
+    bool IsOpen() { return file.data != NULL; }
+
+    bool Find(const char* name, const unsigned char** data, size_t* size);
+
+private:
+
+    MappedFile file;
+    const AssetPackHeader* header = NULL;
+    const AssetPackEntry* entries = NULL;
+};
+
+extern AssetPack assetPack;
+
+// Looks in the pack first, then falls back to the loose file
+bool ReadAsset(const char* path, AssetData* asset);
+
+// --pack-assets out.pak file...
+int PackAssets(int argc, char* argv[]);
@@ -0,0 +1,298 @@
+#include "Benchmark.h"
+#include "Entity.h"
+#include "Renderer.h"
+#include "AssetPack.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+volatile float benchmarkSink;
+
+bool Benchmark::Selected(const char* name) const
+{
+    return filter.empty() || strstr(name, filter.c_str()) != NULL;
+}
+
+static double Median(std::vector<double>* values)
+{
+    std::sort(values->begin(), values->end());
+    size_t count = values->size();
+    if (count == 0) return 0;
+    if (count % 2 == 1) return (*values)[count / 2];
+    return ((*values)[count / 2 - 1] + (*values)[count / 2]) / 2.0;
+}
+
+void Benchmark::Record(const char* name, double itemsPerOp, long long iterations, std::vector<double>* perOp)
+{
+    BenchmarkResult result;
+    result.name = name;
+    result.samples = (int)perOp->size();
+    result.iterations = iterations;
+    result.itemsPerOp = itemsPerOp;
+    result.medianNs = Median(perOp);
+    result.minNs = perOp->empty() ? 0 : perOp->front();
+
+    std::vector<double> deviations;
+    deviations.reserve(perOp->size());
+    for (double value : *perOp) deviations.push_back(fabs(value - result.medianNs));
+    result.madNs = Median(&deviations);
+
+    results.push_back(result);
+
+    double throughput = result.medianNs > 0 ? itemsPerOp * 1e9 / result.medianNs : 0;
+    fprintf(stderr, "%-32s %12.1f ns  +-%5.1f%%  %14.0f items/s\n", name, result.medianNs,
+        result.medianNs > 0 ? 100.0 * result.madNs / result.medianNs : 0.0, throughput);
+}
+
+void Benchmark::WriteJson(FILE* file) const
+{
+#ifdef NDEBUG
+    const char* build = "release";
+#else
+    const char* build = "debug";
+#endif
+    fprintf(file, "{\n  \"build\": \"%s\",\n  \"benchmarks\": [", build);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        double throughput = result.medianNs > 0 ? result.itemsPerOp * 1e9 / result.medianNs : 0;
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"samples\": %d, \"iterations\": %lld, "
+            "\"median_ns\": %.3f, \"mad_ns\": %.3f, \"min_ns\": %.3f, "
+            "\"items_per_op\": %g, \"items_per_second\": %.1f}",
+            i == 0 ? "" : ",", result.name.c_str(), result.samples, result.iterations,
+            result.medianNs, result.madNs, result.minNs, result.itemsPerOp, throughput);
+    }
+    fprintf(file, "\n  ]\n}\n");
+}
+
+// A row of unit platforms under the entity, like the level floor. The entity
+// starts sinking into the middle one so the resolve path runs too.
+struct CollisionScene {
+    std::vector<Entity> platforms;
+    std::vector<Entity*> candidates;
+    Entity entity;
+
+    CollisionScene(int platformCount)
+    {
+        platforms.resize(platformCount);
+        for (int i = 0; i < platformCount; i++) {
+            platforms[i].entityType = PLATFORM;
+            platforms[i].position = glm::vec3((float)(i - platformCount / 2), -3.0f, 0);
+            candidates.push_back(&platforms[i]);
+        }
+        entity.entityType = PLAYER;
+        entity.width = 0.8f;
+        entity.speed = 1.5f;
+        entity.acceleration = glm::vec3(0, -9.81f, 0);
+        Reset();
+    }
+
+    void Reset()
+    {
+        entity.position = glm::vec3(0.1f, -2.05f, 0);
+        entity.velocity = glm::vec3(0.5f, -1.0f, 0);
+        entity.movement = glm::vec3(1.0f, 0, 0);
+    }
+};
+
+static void BenchCollision(Benchmark* bench)
+{
+    {
+        CollisionScene scene(2);
+        Entity* a = &scene.entity;
+        Entity* hit = &scene.platforms[1];
+        Entity* miss = &scene.platforms[0];
+        bench->Run("check_collision/hit", 1, [&](long long n) {
+            int count = 0;
+            for (long long i = 0; i < n; i++) count += a->CheckCollision(hit);
+            benchmarkSink = (float)count;
+        });
+        bench->Run("check_collision/miss", 1, [&](long long n) {
+            int count = 0;
+            for (long long i = 0; i < n; i++) count += a->CheckCollision(miss);
+            benchmarkSink = (float)count;
+        });
+    }
+
+    const int counts[] = { 1, 16, 256, 4096 };
+    for (int count : counts) {
+        CollisionScene scene(count);
+        char name[64];
+
+        snprintf(name, sizeof(name), "check_collisions_y/%d", count);
+        bench->Run(name, count, [&](long long n) {
+            for (long long i = 0; i < n; i++) {
+                scene.Reset();
+                scene.entity.CheckCollisionsY(scene.candidates.data(), count);
+            }
+            benchmarkSink = scene.entity.position.y;
+        });
+
+        snprintf(name, sizeof(name), "check_collisions_x/%d", count);
+        bench->Run(name, count, [&](long long n) {
+            for (long long i = 0; i < n; i++) {
+                scene.Reset();
+                scene.entity.CheckCollisionsX(scene.candidates.data(), count);
+            }
+            benchmarkSink = scene.entity.position.x;
+        });
+    }
+}
+
+static void BenchUpdate(Benchmark* bench)
+{
+    // The collision grid hands each entity a handful of nearby platforms
+    const int counts[] = { 4, 16, 64 };
+    for (int count : counts) {
+        CollisionScene scene(count);
+        Entity player;
+        player.position = glm::vec3(2.0f, -2.0f, 0);
+        char name[64];
+
+        snprintf(name, sizeof(name), "entity_update/player/%d", count);
+        bench->Run(name, 1, [&](long long n) {
+            scene.entity.entityType = PLAYER;
+            for (long long i = 0; i < n; i++) {
+                scene.Reset();
+                scene.entity.Update(1.0f / 60.0f, &player, scene.candidates.data(), count);
+            }
+            benchmarkSink = scene.entity.position.x;
+        });
+
+        const AIType types[] = { WALKER, WAITANDGO, JUMPER };
+        const char* typeNames[] = { "walker", "waitandgo", "jumper" };
+        for (int t = 0; t < 3; t++) {
+            snprintf(name, sizeof(name), "entity_update/%s/%d", typeNames[t], count);
+            bench->Run(name, 1, [&](long long n) {
+                scene.entity.entityType = ENEMY;
+                scene.entity.aiType = types[t];
+                scene.entity.aiState = IDLE;
+                for (long long i = 0; i < n; i++) {
+                    scene.Reset();
+                    scene.entity.Update(1.0f / 60.0f, &player, scene.candidates.data(), count);
+                }
+                benchmarkSink = scene.entity.position.x;
+            });
+        }
+    }
+}
+
+static void BenchText(Benchmark* bench)
+{
+    const char* strings[] = { "You Lose!", "The quick brown fox jumps over the lazy dog, 0123456789 times!!" };
+    for (const char* text : strings) {
+        size_t length = strlen(text);
+        std::vector<float> vertices(length * 12);
+        std::vector<float> texCoords(length * 12);
+        char name[64];
+        snprintf(name, sizeof(name), "text_vertices/%zu", length);
+        bench->Run(name, (double)length, [&](long long n) {
+            for (long long i = 0; i < n; i++) {
+                BuildTextVertices(text, length, 0.5f, -0.25f, vertices.data(), texCoords.data());
+            }
+            benchmarkSink = vertices.back() + texCoords.back();
+        });
+    }
+}
+
+static void BenchAtlas(Benchmark* bench)
+{
+    bench->Run("atlas_region", 1, [&](long long n) {
+        float sum = 0;
+        for (long long i = 0; i < n; i++) {
+            float u, v, width, height;
+            AtlasRegion((int)(i & 15), 4, 4, &u, &v, &width, &height);
+            sum += u + v + width + height;
+        }
+        benchmarkSink = sum;
+    });
+
+    // Through the sprite path as the game uses it, including the packet push
+    Entity entity;
+    entity.animCols = 4;
+    entity.animRows = 4;
+    RenderPacket packet;
+    packet.sprites.reserve(1024);
+    bench->Run("draw_sprite_from_atlas", 1, [&](long long n) {
+        for (long long i = 0; i < n; i++) {
+            if (packet.sprites.size() == 1024) packet.sprites.clear();
+            entity.DrawSpriteFromTextureAtlas(&packet, 1, (int)(i & 15));
+        }
+        benchmarkSink = packet.sprites.back().u;
+    });
+}
+
+static void BenchDecode(Benchmark* bench)
+{
+    const char* paths[] = { "font1.png", "player.png", "tileset.png", "enemy.png" };
+    for (const char* path : paths) {
+        char name[64];
+        snprintf(name, sizeof(name), "png_decode/%s", path);
+        if (bench->Selected(name) == false) continue;
+
+        AssetData asset;
+        int width, height, n;
+        if (ReadAsset(path, &asset) == false ||
+            stbi_info_from_memory(asset.data, (int)asset.size, &width, &height, &n) == 0) {
+            fprintf(stderr, "%-32s skipped, %s not found\n", name, path);
+            continue;
+        }
+
+        // Throughput is in pixels
+        bench->Run(name, (double)width * height, [&](long long count) {
+            for (long long i = 0; i < count; i++) {
+                int w, h, channels;
+                unsigned char* pixels = stbi_load_from_memory(asset.data, (int)asset.size, &w, &h, &channels, STBI_rgb_alpha);
+                benchmarkSink = pixels != NULL ? pixels[0] : 0;
+                stbi_image_free(pixels);
+            }
+        });
+    }
+}
+
+int RunBenchmarks(int argc, char* argv[])
+{
+    Benchmark bench;
+    const char* outPath = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            bench.samples = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--sample-ms") == 0 && i + 1 < argc) {
+            bench.sampleMilliseconds = std::max(0.1, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        }
+        else if (argv[i][0] != '-') {
+            bench.filter = argv[i];
+        }
+        else {
+            printf("usage: --bench [filter] [--samples n] [--sample-ms ms] [--out results.json]\n");
+            return 1;
+        }
+    }
+
+    BenchCollision(&bench);
+    BenchUpdate(&bench);
+    BenchText(&bench);
+    BenchAtlas(&bench);
+    BenchDecode(&bench);
+
+    if (bench.results.empty()) {
+        fprintf(stderr, "No benchmark matches \"%s\"\n", bench.filter.c_str());
+        return 1;
+    }
+
+    FILE* file = outPath != NULL ? fopen(outPath, "w") : stdout;
+    if (file == NULL) {
+        fprintf(stderr, "Unable to write %s\n", outPath);
+        return 1;
+    }
+    bench.WriteJson(file);
+    if (file != stdout) fclose(file);
+    return 0;
+}
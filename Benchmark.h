@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// --bench [filter] [--samples n] [--sample-ms ms] [--out results.json]
+// Times the engine's hot functions without a window or GL context. Each benchmark
+// runs in batches sized to take about sample-ms, and reports the median time per
+// operation, its median absolute deviation and throughput. Results go to stdout
+// as JSON unless --out is given; progress is printed to stderr.
+int RunBenchmarks(int argc, char* argv[]);
+
+struct BenchmarkResult {
+    std::string name;
+    int samples = 0;
+    long long iterations = 0;  // per sample
+    double medianNs = 0;       // per operation
+    double madNs = 0;
+    double minNs = 0;
+    double itemsPerOp = 1;     // what throughput counts, e.g. platforms tested
+};
+
+class Benchmark {
+public:
+    std::string filter;
+    int samples = 31;
+    double sampleMilliseconds = 5.0;
+
+    std::vector<BenchmarkResult> results;
+
+    bool Selected(const char* name) const;
+
+    // body(iterations) must perform the operation that many times
+    template <typename Body>
+    void Run(const char* name, double itemsPerOp, Body body)
+    {
+        if (Selected(name) == false) return;
+
+        // Grow the batch until it is long enough to time reliably
+        long long iterations = 1;
+        for (;;) {
+            double elapsed = Time(body, iterations);
+            if (elapsed >= sampleMilliseconds * 1e6 * 0.25 || iterations >= (1LL << 40)) {
+                double scale = sampleMilliseconds * 1e6 / (elapsed > 1.0 ? elapsed : 1.0);
+                iterations = (long long)(iterations * scale);
+                if (iterations < 1) iterations = 1;
+                break;
+            }
+            iterations *= 4;
+        }
+
+        Time(body, iterations); // warm up
+
+        std::vector<double> perOp;
+        perOp.reserve(samples);
+        for (int i = 0; i < samples; i++) {
+            perOp.push_back(Time(body, iterations) / (double)iterations);
+        }
+        Record(name, itemsPerOp, iterations, &perOp);
+    }
+
+    void WriteJson(FILE* file) const;
+
+private:
+    template <typename Body>
+    static double Time(Body& body, long long iterations)
+    {
+        auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        auto end = std::chrono::steady_clock::now();
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+
+    void Record(const char* name, double itemsPerOp, long long iterations, std::vector<double>* perOp);
+};
+
+// Results are written here so the compiler cannot drop the work being timed
+extern volatile float benchmarkSink;
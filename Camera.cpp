@@ -0,0 +1,85 @@
+#include "Camera.h"
+#include "Entity.h"
+
+Camera::Camera()
+{
+    position = glm::vec3(0);
+    viewMatrix = glm::mat4(1.0f);
+    projectionMatrix = glm::mat4(1.0f);
+    UpdateMatrices();
+}
+
+void Camera::SetBounds(float left, float right, float bottom, float top)
+{
+    hasBounds = true;
+    boundsLeft = left;
+    boundsRight = right;
+    boundsBottom = bottom;
+    boundsTop = top;
+    ClampToBounds();
+    UpdateMatrices();
+}
+
+void Camera::SetZoom(float newZoom)
+{
+    zoom = glm::clamp(newZoom, minZoom, maxZoom);
+    ClampToBounds();
+    UpdateMatrices();
+}
+
+void Camera::SnapToTarget()
+{
+    if (target != NULL) {
+        position.x = target->position.x;
+        position.y = target->position.y;
+    }
+    ClampToBounds();
+    UpdateMatrices();
+}
+
+void Camera::Update(float deltaTime)
+{
+    if (target != NULL) {
+        // Ease towards the target so small hops don't jerk the whole screen
+        float t = glm::min(1.0f, followSpeed * deltaTime);
+        position.x += (target->position.x - position.x) * t;
+        position.y += (target->position.y - position.y) * t;
+    }
+    ClampToBounds();
+    UpdateMatrices();
+}
+
+void Camera::GetVisibleRect(float* left, float* bottom, float* right, float* top)
+{
+    float w = halfWidth / zoom;
+    float h = halfHeight / zoom;
+    *left = position.x - w;
+    *right = position.x + w;
+    *bottom = position.y - h;
+    *top = position.y + h;
+}
+
+void Camera::ClampToBounds()
+{
+    if (hasBounds == false) return;
+
+    float w = halfWidth / zoom;
+    float h = halfHeight / zoom;
+
+    // If the level is smaller than the view on an axis, keep it centered instead
+    if (boundsRight - boundsLeft <= w * 2.0f) position.x = (boundsLeft + boundsRight) / 2.0f;
+    else position.x = glm::clamp(position.x, boundsLeft + w, boundsRight - w);
+
+    if (boundsTop - boundsBottom <= h * 2.0f) position.y = (boundsBottom + boundsTop) / 2.0f;
+    else position.y = glm::clamp(position.y, boundsBottom + h, boundsTop - h);
+}
+
+void Camera::UpdateMatrices()
+{
+    float w = halfWidth / zoom;
+    float h = halfHeight / zoom;
+    projectionMatrix = glm::ortho(-w, w, -h, h, -1.0f, 1.0f);
+
+    viewMatrix = glm::mat4(1.0f);
+    viewMatrix = glm::translate(viewMatrix, glm::vec3(-position.x, -position.y, 0));
+}
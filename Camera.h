@@ -0,0 +1,45 @@
+#pragma once
+
+#include "glm/mat4x4.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+class Entity;
+
+class Camera {
+public:
+
+    glm::vec3 position;
+
+    Entity* target = NULL;
+    float followSpeed = 6.0f;
+
+    // Half the size of the visible area at zoom 1
+    float halfWidth = 5.0f;
+    float halfHeight = 3.75f;
+
+    float zoom = 1.0f;
+    float minZoom = 0.25f;
+    float maxZoom = 4.0f;
+
+    bool hasBounds = false;
+    float boundsLeft = 0;
+    float boundsRight = 0;
+    float boundsBottom = 0;
+    float boundsTop = 0;
+
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+
+    Camera();
+
+    void SetBounds(float left, float right, float bottom, float top);
+    void SetZoom(float newZoom);
+    void SnapToTarget();
+    void Update(float deltaTime);
+
+    void GetVisibleRect(float* left, float* bottom, float* right, float* top);
+
+private:
+    void ClampToBounds();
+    void UpdateMatrices();
+};
@@ -0,0 +1,30 @@
+#include "DynamicResolution.h"
+
+#define SCALE_DOWN_STEP 0.1f
+#define SCALE_UP_STEP 0.05f
+#define SETTLE_FRAMES 30
+
+bool DynamicResolution::Update(double frameMilliseconds)
+{
+    if (enabled == false) return false;
+
+    if (smoothed == 0) smoothed = frameMilliseconds;
+    else smoothed = smoothed * 0.9 + frameMilliseconds * 0.1;
+
+    if (settleFrames > 0) {
+        settleFrames--;
+        return false;
+    }
+
+    float next = scale;
+    if (smoothed > budget * 0.9) next = scale - SCALE_DOWN_STEP;
+    else if (smoothed < budget * 0.6) next = scale + SCALE_UP_STEP;
+
+    if (next < minScale) next = minScale;
+    if (next > maxScale) next = maxScale;
+    if (next == scale) return false;
+
+    scale = next;
+    settleFrames = SETTLE_FRAMES;
+    return true;
+}
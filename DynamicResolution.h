@@ -0,0 +1,25 @@
+#pragma once
+
+// Picks the render scale from how long recent frames took to draw. Scales down
+// quickly when over budget and back up slowly once there is plenty of headroom.
+class DynamicResolution {
+public:
+
+    bool enabled = true;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+
+    // Milliseconds a frame may spend drawing
+    double budget = 1000.0 / 60.0;
+
+    float scale = 1.0f;
+
+    // Feed the cost of the frame just drawn. Returns true if scale changed.
+    bool Update(double frameMilliseconds);
+
+private:
+
+    double smoothed = 0;
+    // Frames to wait after a change so the cost reflects the new scale
+    int settleFrames = 0;
+};
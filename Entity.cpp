@@ -1,4 +1,7 @@
 #include "Entity.h"
+#include "Metrics.h"
+#include "Profiler.h"
+#include "TextureStreamer.h"
 
 Entity::Entity()
 {
@@ -26,14 +29,16 @@ bool Entity::CheckCollision(Entity* other)
     return false;
 }
 
-void Entity::CheckCollisionsY(Entity* objects, int objectCount)
+void Entity::CheckCollisionsY(Entity** objects, int objectCount)
 {
+    int contacts = 0;
     for (int i = 0; i < objectCount; i++)
     {
-        Entity* object = &objects[i];
+        Entity* object = objects[i];
 
         if (CheckCollision(object))
         {
+            contacts++;
             float ydist = fabs(position.y - object->position.y);
             float penetrationY = fabs(ydist - (height / 2.0f) - (object->height / 2.0f));
             if (velocity.y > 0) {
@@ -52,16 +57,20 @@ void Entity::CheckCollisionsY(Entity* objects, int objectCount)
             }
         }
     }
+    metrics.Add(METRIC_COLLISION_TESTS, objectCount);
+    metrics.Add(METRIC_CONTACTS, contacts);
 }
 
-void Entity::CheckCollisionsX(Entity* objects, int objectCount)
+void Entity::CheckCollisionsX(Entity** objects, int objectCount)
 {
+    int contacts = 0;
     for (int i = 0; i < objectCount; i++)
     {
-        Entity* object = &objects[i];
+        Entity* object = objects[i];
 
         if (CheckCollision(object))
         {
+            contacts++;
             float xdist = fabs(position.x - object->position.x);
             float penetrationX = fabs(xdist - (width / 2.0f) - (object->width / 2.0f));
             if (velocity.x > 0) {
@@ -76,6 +85,8 @@ void Entity::CheckCollisionsX(Entity* objects, int objectCount)
             }
         }
     }
+    metrics.Add(METRIC_COLLISION_TESTS, objectCount);
+    metrics.Add(METRIC_CONTACTS, contacts);
 }
 void Entity::AIJumper() {
     if (collidedBottom) jump = true;
@@ -122,18 +133,16 @@ void Entity::AI(Entity* player) {
     }
 }
 
-void Entity::Update(float deltaTime, Entity* player, Entity* platforms, int platformCount)
+void Entity::BeginUpdate(float deltaTime)
 {
-    if (isActive == false) return;
-    
+    metrics.Add(METRIC_ENTITIES_UPDATED, 1);
+
     collidedTop = false;
     collidedBottom = false;
     collidedLeft = false;
     collidedRight = false;
     lastCollision = NULL;
 
-    
-
     if (animIndices != NULL) {
         if (glm::length(movement) != 0) {
             animTime += deltaTime;
@@ -152,13 +161,10 @@ void Entity::Update(float deltaTime, Entity* player, Entity* platforms, int plat
             animIndex = 0;
         }
     }
-    CheckCollisionsY(platforms, platformCount);// Fix if needed
-    CheckCollisionsX(platforms, platformCount);// Fix if needed
-    
-    if (entityType == ENEMY) {
-        AI(player);
-    }
+}
 
+void Entity::Integrate(float deltaTime)
+{
     if (jump) {
         jump = false;
         velocity.y += jumpPower;
@@ -174,57 +180,58 @@ void Entity::Update(float deltaTime, Entity* player, Entity* platforms, int plat
     modelMatrix = glm::translate(modelMatrix, position);
 }
 
-void Entity::DrawSpriteFromTextureAtlas(ShaderProgram* program, GLuint textureID, int index)
+void Entity::Update(float deltaTime, Entity* player, Entity** platforms, int platformCount)
 {
-    float u = (float)(index % animCols) / (float)animCols;
-    float v = (float)(index / animCols) / (float)animRows;
-
-    float width = 1.0f / (float)animCols;
-    float height = 1.0f / (float)animRows;
+    if (isActive == false) return;
 
-    float texCoords[] = { u, v + height, u + width, v + height, u + width, v,
-        u, v + height, u + width, v, u, v };
+    BeginUpdate(deltaTime);
 
-    float vertices[] = { -0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5 };
+    {
+        ProfilePhaseScope phase(PROFILE_COLLISION);
+        CheckCollisionsY(platforms, platformCount);// Fix if needed
+        CheckCollisionsX(platforms, platformCount);// Fix if needed
+    }
+    
+    if (entityType == ENEMY) {
+        ProfilePhaseScope phase(PROFILE_AI);
+        AI(player);
+    }
 
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    Integrate(deltaTime);
+}
 
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-    glEnableVertexAttribArray(program->positionAttribute);
+void AtlasRegion(int index, int cols, int rows, float* u, float* v, float* width, float* height)
+{
+    *u = (float)(index % cols) / (float)cols;
+    *v = (float)(index / cols) / (float)rows;
 
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-    glEnableVertexAttribArray(program->texCoordAttribute);
+    *width = 1.0f / (float)cols;
+    *height = 1.0f / (float)rows;
+}
 
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+void Entity::DrawSpriteFromTextureAtlas(RenderPacket* packet, GLuint textureID, int index)
+{
+    float u, v, width, height;
+    AtlasRegion(index, animCols, animRows, &u, &v, &width, &height);
 
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+    packet->sprites.push_back({ textureID, position, u, v, width, height });
 }
 
-void Entity::Render(ShaderProgram* program) {
+void Entity::Render(RenderPacket* packet) {
 
     if (isActive == false) return;
 
-    program->SetModelMatrix(modelMatrix);
+    GLuint texture = textureID;
+    if (streamedTexture != NULL) {
+        texture = streamedTexture->textureID;
+        if (texture == 0) return;
+    }
 
     if (animIndices != NULL) {
-        DrawSpriteFromTextureAtlas(program, textureID, animIndices[animIndex]);
+        DrawSpriteFromTextureAtlas(packet, texture, animIndices[animIndex]);
         return;
     }
 
-    float vertices[] = { -0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5 };
-    float texCoords[] = { 0.0, 1.0, 1.0, 1.0, 1.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0, 0.0 };
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-    glEnableVertexAttribArray(program->positionAttribute);
-
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-    glEnableVertexAttribArray(program->texCoordAttribute);
-
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+    FrameVector<SpriteInstance>& list = entityType == PLATFORM ? packet->tiles : packet->sprites;
+    list.push_back({ texture, position, 0.0f, 0.0f, 1.0f, 1.0f });
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#pragma once
+
 #define GL_SILENCE_DEPRECATION
 
 #ifdef _WINDOWS
@@ -9,7 +11,12 @@
 #include <SDL_opengl.h>
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
-#include "ShaderProgram.h"
+#include "RenderPacket.h"
+
+struct StreamedTexture;
+
+// Texture coordinates of cell index in an atlas of cols x rows equal cells
+void AtlasRegion(int index, int cols, int rows, float* u, float* v, float* width, float* height);
 
 enum EntityType {PLAYER, PLATFORM, ENEMY};
 enum AIType {WALKER, WAITANDGO, JUMPER};
@@ -36,6 +43,8 @@ public:
     float speed;
 
     GLuint textureID;
+    // When set, overrides textureID and the entity is hidden until it has loaded
+    StreamedTexture* streamedTexture = NULL;
 
     glm::mat4 modelMatrix;
 
@@ -52,6 +61,8 @@ public:
     int animRows = 0;
 
     bool isActive = true;
+    // Index of the level spawn record this entity came from, -1 if none
+    int spawnIndex = -1;
 
     bool collidedTop = false;
     bool collidedBottom = false;
@@ -63,11 +74,14 @@ public:
     Entity();
 
     bool CheckCollision(Entity* other);
-    void CheckCollisionsY(Entity* objects, int objectCount);
-    void CheckCollisionsX(Entity* objects, int objectCount);
-    void Update(float deltaTime, Entity *player, Entity* platforms, int platformCount);
-    void Render(ShaderProgram* program);
-    void DrawSpriteFromTextureAtlas(ShaderProgram* program, GLuint textureID, int index);
+    void CheckCollisionsY(Entity** objects, int objectCount);
+    void CheckCollisionsX(Entity** objects, int objectCount);
+    void Update(float deltaTime, Entity *player, Entity** platforms, int platformCount);
+    // The steps of Update, for callers that run each one over every entity in turn
+    void BeginUpdate(float deltaTime);
+    void Integrate(float deltaTime);
+    void Render(RenderPacket* packet);
+    void DrawSpriteFromTextureAtlas(RenderPacket* packet, GLuint textureID, int index);
     
     void AI(Entity* player);
     void AIWalker();
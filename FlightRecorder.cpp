@@ -0,0 +1,165 @@
+#include "FlightRecorder.h"
+#include "Trace.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <cstdio>
+
+FlightRecorder flightRecorder;
+
+void FlightRecorder::Start()
+{
+    if (enabled == false || capacity <= 0) return;
+
+    ring.resize(capacity);
+    pending.resize(capacity);
+    snapshot.entities.reserve(maxEntities);
+
+    quit = false;
+    writer = std::thread(&FlightRecorder::WriterMain, this);
+}
+
+void FlightRecorder::Stop()
+{
+    if (writer.joinable() == false) return;
+
+    // A spike still waiting for its frames after is written with what there is, once
+    // the writer is done with the last one
+    if (remainingAfter > 0) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return writing == false; });
+        }
+        Hand();
+    }
+    remainingAfter = -1;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    writer.join();
+}
+
+FlightSnapshot* FlightRecorder::Record(const FlightFrame& frame)
+{
+    if (ring.empty()) return NULL;
+
+    ring[recorded % ring.size()] = frame;
+    recorded++;
+
+    if (remainingAfter > 0) {
+        if (--remainingAfter == 0) {
+            Hand();
+            remainingAfter = -1;
+        }
+        return NULL;
+    }
+
+    // The pacer's wait is idle time, at a low --fps it alone would make every frame a spike
+    double work = frame.row.frameMilliseconds - frame.phases[STAT_PACING_WAIT];
+    if (recorded <= (uint64_t)warmupFrames || work <= spikeMilliseconds) return NULL;
+    if (dumps >= maxDumps || frame.row.time - lastDumpTime < cooldownSeconds) return NULL;
+    {
+        // The last dump is still being written from the snapshot and pending frames
+        std::lock_guard<std::mutex> lock(mutex);
+        if (writing) return NULL;
+    }
+
+    dumps++;
+    lastDumpTime = frame.row.time;
+    spikeFrame = frame.row.frame;
+    spikeFrameMilliseconds = work;
+    remainingAfter = std::max(1, framesAfter);
+
+    snapshot.entities.clear();
+    snapshot.entityCount = 0;
+    return &snapshot;
+}
+
+void FlightRecorder::Hand()
+{
+    size_t count = (size_t)std::min<uint64_t>(recorded, ring.size());
+    size_t first = (size_t)((recorded - count) % ring.size());
+    for (size_t i = 0; i < count; i++) pending[i] = ring[(first + i) % ring.size()];
+    pendingCount = count;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        writing = true;
+    }
+    wake.notify_one();
+}
+
+void FlightRecorder::WriterMain()
+{
+    TRACE_THREAD_NAME("flight recorder");
+    profiler.RegisterThread("flight recorder");
+    ALLOC_TAG("flight recorder");
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return writing || quit; });
+            if (writing == false) return;
+        }
+
+        std::string path = directory + "/flight_" + std::to_string(spikeFrame) + ".json";
+        Write(path.c_str());
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            writing = false;
+        }
+        // Stop may be waiting to hand over a last spike
+        wake.notify_all();
+    }
+}
+
+void FlightRecorder::Write(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Frame %llu took %.1f ms, unable to write %s\n", (unsigned long long)spikeFrame, spikeFrameMilliseconds, path);
+        return;
+    }
+
+    fprintf(file, "{\n  \"spike_frame\": %llu,\n  \"spike_ms\": %.3f,\n  \"budget_ms\": %.3f,\n",
+        (unsigned long long)spikeFrame, spikeFrameMilliseconds, spikeMilliseconds);
+
+    fprintf(file, "  \"phases\": [");
+    for (int i = 0; i < STAT_COUNT; i++) fprintf(file, "%s\"%s\"", i == 0 ? "" : ", ", FrameStats::Name((StatPhase)i));
+    fprintf(file, "],\n  \"counters\": [");
+    for (int i = 0; i < METRIC_COUNT; i++) fprintf(file, "%s\"%s\"", i == 0 ? "" : ", ", Metrics::Name((Metric)i));
+    fprintf(file, "],\n  \"frames\": [");
+
+    for (size_t i = 0; i < pendingCount; i++) {
+        const FlightFrame& frame = pending[i];
+        fprintf(file, "%s\n    {\"frame\": %llu, \"time\": %.4f, \"ms\": %.3f, \"steps\": %d, \"input\": %d, "
+            "\"player\": [%.3f, %.3f], \"phases\": [", i == 0 ? "" : ",", (unsigned long long)frame.row.frame,
+            frame.row.time, frame.row.frameMilliseconds, frame.steps, frame.input, frame.playerX, frame.playerY);
+        for (int p = 0; p < STAT_COUNT; p++) fprintf(file, "%s%.3f", p == 0 ? "" : ", ", frame.phases[p]);
+        fprintf(file, "], \"counters\": [");
+        for (int c = 0; c < METRIC_COUNT; c++) fprintf(file, "%s%llu", c == 0 ? "" : ", ", (unsigned long long)frame.row.values[c]);
+        fprintf(file, "]}");
+    }
+
+    const FlightSnapshot& world = snapshot;
+    fprintf(file, "\n  ],\n  \"world\": {\"game_won\": %s, \"game_over\": %s, \"camera\": [%.3f, %.3f, %.3f], "
+        "\"active_chunks\": %d, \"particles\": %d, \"entity_count\": %d, \"entities\": [",
+        world.gameWon ? "true" : "false", world.gameOver ? "true" : "false", world.cameraX, world.cameraY, world.zoom,
+        world.activeChunks, world.particles, world.entityCount);
+    for (size_t i = 0; i < world.entities.size(); i++) {
+        const FlightEntity& entity = world.entities[i];
+        fprintf(file, "%s\n    {\"type\": %d, \"ai\": %d, \"state\": %d, \"active\": %s, \"position\": [%.3f, %.3f], "
+            "\"velocity\": [%.3f, %.3f]}", i == 0 ? "" : ",", entity.entityType, entity.aiType, entity.aiState,
+            entity.isActive ? "true" : "false", entity.x, entity.y, entity.velocityX, entity.velocityY);
+    }
+    fprintf(file, "\n  ]}\n}\n");
+
+    bool written = ferror(file) == 0;
+    fclose(file);
+    if (written) printf("Frame %llu took %.1f ms, wrote %s\n", (unsigned long long)spikeFrame, spikeFrameMilliseconds, path);
+    else printf("Frame %llu took %.1f ms, unable to write %s\n", (unsigned long long)spikeFrame, spikeFrameMilliseconds, path);
+}
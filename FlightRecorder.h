@@ -0,0 +1,102 @@
+#pragma once
+
+#include "FrameStats.h"
+#include "Metrics.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One frame as the flight recorder keeps it
+struct FlightFrame {
+    MetricsRow row;
+    double phases[STAT_COUNT];  // ms
+    int steps;
+    uint8_t input;  // INPUT_ flags
+    float playerX, playerY;
+};
+
+struct FlightEntity {
+    uint8_t entityType;
+    uint8_t aiType;
+    uint8_t aiState;
+    uint8_t isActive;
+    float x, y;
+    float velocityX, velocityY;
+};
+
+// The world on the frame that spiked. The player is the first entity.
+struct FlightSnapshot {
+    bool gameWon;
+    bool gameOver;
+    float cameraX, cameraY, zoom;
+    int activeChunks;
+    int particles;
+    // Stops at capacity, entityCount says how many there were
+    std::vector<FlightEntity> entities;
+    int entityCount;
+
+    void Add(const FlightEntity& entity)
+    {
+        if (entities.size() < entities.capacity()) entities.push_back(entity);
+        entityCount++;
+    }
+};
+
+// Always on ring of the last frames. When a frame's work, its time less the pacer's
+// wait, takes longer than spikeMilliseconds the world is snapshot, framesAfter more frames are recorded, and the ring is written
+// as JSON to directory/flight_<frame>.json by a background thread. Recording a frame
+// is a copy into the ring, nothing is allocated once Start has run.
+class FlightRecorder {
+public:
+
+    bool enabled = true;
+    int capacity = 600;
+    double spikeMilliseconds = 50.0;
+    int framesAfter = 60;
+    // Startup frames are always slow
+    int warmupFrames = 120;
+    // Between dumps, so a long stall doesn't write one file per frame
+    double cooldownSeconds = 10.0;
+    int maxDumps = 16;
+    int maxEntities = 4096;
+    std::string directory = ".";
+
+    ~FlightRecorder() { Stop(); }
+
+    void Start();
+    void Stop();
+
+    // Main thread, once per frame. Returns the snapshot to fill if this frame spiked.
+    FlightSnapshot* Record(const FlightFrame& frame);
+
+private:
+
+    std::vector<FlightFrame> ring;
+    uint64_t recorded = 0;
+
+    FlightSnapshot snapshot;
+    uint64_t spikeFrame = 0;
+    double spikeFrameMilliseconds = 0;
+    int remainingAfter = -1;
+    double lastDumpTime = -1e9;
+    int dumps = 0;
+
+    // Handed to the writer, oldest frame first
+    std::vector<FlightFrame> pending;
+    size_t pendingCount = 0;
+    bool writing = false;
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+
+    void Hand();
+    void WriterMain();
+    void Write(const char* path);
+};
+
+extern FlightRecorder flightRecorder;
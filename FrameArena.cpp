@@ -0,0 +1,82 @@
+#include "FrameArena.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+size_t FrameArena::threadCapacity = 1 << 20;
+
+// Through operator new so the allocation tracker sees the arena's own heap use too
+FrameArena::FrameArena(size_t capacity) : capacity(capacity)
+{
+    buffer = (unsigned char*)::operator new(capacity);
+}
+
+FrameArena::~FrameArena()
+{
+    Reset();
+    ::operator delete(buffer);
+}
+
+FrameArena& FrameArena::ForThread()
+{
+    static thread_local FrameArena arena(threadCapacity);
+    return arena;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    // Aligned as an address, the buffer itself is only aligned for max_align_t
+    uintptr_t base = (uintptr_t)buffer;
+    size_t start = (size_t)(((base + used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+    if (start + size <= capacity) {
+        used = start + size;
+        if (used > highWater) highWater = used;
+        return buffer + start;
+    }
+
+    // Out of room, this frame's spill goes to the heap and is freed by Reset. operator
+    // new only aligns for max_align_t, so the block has room to align past its header.
+    Overflow* block = (Overflow*)::operator new(sizeof(Overflow) + alignment - 1 + size);
+    block->next = overflows;
+    overflows = block;
+    overflowBytes += size;
+    return (void*)(((uintptr_t)(block + 1) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+const char* FrameArena::CopyString(const char* text)
+{
+    size_t length = strlen(text) + 1;
+    char* copy = AllocateArray<char>(length);
+    memcpy(copy, text, length);
+    return copy;
+}
+
+void FrameArena::Rewind(size_t mark)
+{
+    if (mark < used) used = mark;
+}
+
+void FrameArena::Reset()
+{
+    used = 0;
+
+    while (overflows != NULL) {
+        Overflow* next = overflows->next;
+        ::operator delete(overflows);
+        overflows = next;
+    }
+    if (overflowBytes == 0) return;
+
+    // Grown to hold the frame that spilled with room to spare, so a steady overflow
+    // costs one reallocation instead of heap blocks every frame
+    size_t grown = capacity + overflowBytes;
+    grown += grown / 2;
+    printf("Frame arena of %zu bytes overflowed by %zu bytes, growing it to %zu\n", capacity, overflowBytes, grown);
+    ::operator delete(buffer);
+    buffer = (unsigned char*)::operator new(grown);
+    capacity = grown;
+    overflowBytes = 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Bump allocator for data that lives for one frame. Allocating is a pointer bump,
+// nothing is freed individually, everything goes at once with Reset, or back to a
+// mark with Rewind. When the buffer runs out allocations spill to the heap until the
+// next Reset, which reports the overflow and grows the buffer to fit.
+class FrameArena {
+public:
+
+    explicit FrameArena(size_t capacity);
+    ~FrameArena();
+
+    void* Allocate(size_t size, size_t alignment);
+
+    template <typename T>
+    T* AllocateArray(size_t count) { return (T*)Allocate(sizeof(T) * count, alignof(T)); }
+
+    // Copies a string in, for text that has to outlive the caller's buffer
+    const char* CopyString(const char* text);
+
+    size_t Mark() const { return used; }
+    void Rewind(size_t mark);
+    void Reset();
+
+    size_t Used() const { return used; }
+    size_t Capacity() const { return capacity; }
+    size_t HighWater() const { return highWater; }
+
+    // The arena of the calling thread, created on first use
+    static FrameArena& ForThread();
+    static size_t threadCapacity;
+
+private:
+
+    struct Overflow {
+        Overflow* next;
+    };
+
+    unsigned char* buffer;
+    size_t capacity;
+    size_t used = 0;
+    size_t highWater = 0;
+
+    Overflow* overflows = NULL;
+    size_t overflowBytes = 0;
+
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+};
+
+// Gives back everything allocated from the arena inside the enclosing block
+class FrameArenaScope {
+public:
+    FrameArenaScope(FrameArena& arena) : arena(arena), mark(arena.Mark()) {}
+    ~FrameArenaScope() { arena.Rewind(mark); }
+
+private:
+    FrameArena& arena;
+    size_t mark;
+};
+
+// Lets standard containers allocate from an arena. Freeing does nothing, the
+// storage comes back when the arena is reset.
+template <typename T>
+class FrameAllocator {
+public:
+    typedef T value_type;
+
+    FrameArena* arena;
+
+    FrameAllocator(FrameArena* arena) : arena(arena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->AllocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const FrameAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -0,0 +1,55 @@
+#include "FramePacer.h"
+#include "FrameStats.h"
+#include "Trace.h"
+
+#include <SDL.h>
+
+#include <cstring>
+#include <thread>
+
+void FramePacer::Wait()
+{
+    if (targetFps <= 0) return;
+    TRACE_SCOPE("FramePacer::Wait");
+
+    double period = 1000.0 / targetFps;
+    double start = FrameStats::Now();
+
+    if (nextFrame == 0) nextFrame = start;
+    nextFrame += period;
+
+    // After a long hitch start over instead of rushing through a burst of frames
+    if (nextFrame < start - period) nextFrame = start;
+
+    while (true) {
+        double remaining = nextFrame - FrameStats::Now();
+        if (remaining <= 0) break;
+
+        if (remaining < sleepOvershoot + 1.0) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        Uint32 sleepMilliseconds = (Uint32)(remaining - sleepOvershoot);
+        double beforeSleep = FrameStats::Now();
+        SDL_Delay(sleepMilliseconds);
+        double overshoot = FrameStats::Now() - beforeSleep - sleepMilliseconds;
+
+        // Grow fast when the scheduler gets sloppier, shrink slowly
+        if (overshoot > sleepOvershoot) sleepOvershoot = overshoot;
+        else sleepOvershoot = sleepOvershoot * 0.99 + overshoot * 0.01;
+        if (sleepOvershoot < 0.25) sleepOvershoot = 0.25;
+        if (sleepOvershoot > 4.0) sleepOvershoot = 4.0;
+    }
+
+    frameStats.Record(STAT_PACING_WAIT, FrameStats::Now() - start);
+}
+
+bool FramePacer::ParseVsync(const char* text, VsyncMode* mode)
+{
+    if (strcmp(text, "off") == 0) *mode = VSYNC_OFF;
+    else if (strcmp(text, "on") == 0) *mode = VSYNC_ON;
+    else if (strcmp(text, "adaptive") == 0) *mode = VSYNC_ADAPTIVE;
+    else return false;
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Values are SDL swap intervals
+enum VsyncMode { VSYNC_ADAPTIVE = -1, VSYNC_OFF = 0, VSYNC_ON = 1 };
+
+// Keeps the main loop at targetFps instead of spinning. Waits sleep for the bulk
+// of the remaining time and spin only for the last stretch, where SDL_Delay
+// would be too coarse.
+class FramePacer {
+public:
+
+    // 0 runs unlimited
+    float targetFps = 60.0f;
+    VsyncMode vsync = VSYNC_ON;
+
+    // Don't draw a frame when no simulation step ran, it would be identical to the last
+    bool skipIdleFrames = true;
+
+    // Call at the end of every frame
+    void Wait();
+
+    static bool ParseVsync(const char* text, VsyncMode* mode);
+
+private:
+
+    double nextFrame = 0;
+    // How much later than asked SDL_Delay tends to return, in milliseconds
+    double sleepOvershoot = 1.0;
+};
@@ -0,0 +1,125 @@
+#include "FrameStats.h"
+
+#include <cstdio>
+
+FrameStats frameStats;
+
+static const char* statNames[STAT_COUNT] = {
+    "input", "update", "submit", "wait",
+    "draw", "swap", "present interval",
+    "gpu tiles", "gpu sprites", "gpu particles", "gpu text"
+};
+
+double FrameStats::Now()
+{
+    static const double toMilliseconds = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    return (double)SDL_GetPerformanceCounter() * toMilliseconds;
+}
+
+const char* FrameStats::Name(StatPhase phase)
+{
+    return statNames[phase];
+}
+
+void FrameStats::MarkStart()
+{
+    startTime = Now();
+    firstFrameShown = false;
+}
+
+void FrameStats::MarkFrameShown()
+{
+    if (firstFrameShown) return;
+    firstFrameShown = true;
+    printf("Time to first frame: %.1f ms\n", Now() - startTime);
+}
+
+void FrameStats::Record(StatPhase phase, double milliseconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Entry& entry = entries[phase];
+    if (entry.samples == 0 || milliseconds < entry.min) entry.min = milliseconds;
+    if (entry.samples == 0 || milliseconds > entry.max) entry.max = milliseconds;
+    entry.total += milliseconds;
+    entry.samples++;
+    frameTotals[phase] += milliseconds;
+}
+
+void FrameStats::RecordCounters(StatPhase phase, const CounterSample& before, const CounterSample& after)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Entry& entry = entries[phase];
+    AddCounterDelta(before, after, &entry.counters);
+    entry.counterSamples++;
+}
+
+void FrameStats::EndFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < STAT_COUNT; i++) {
+            lastFrameTotals[i] = frameTotals[i];
+            frameTotals[i] = 0;
+        }
+    }
+    frames++;
+
+    double now = Now();
+    if (lastReport == 0) lastReport = now;
+    if (now - lastReport < reportInterval * 1000.0) return;
+
+    if (printEnabled) Report();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < STAT_COUNT; i++) entries[i] = Entry();
+    frames = 0;
+    lastReport = now;
+}
+
+void FrameStats::LastFrame(double milliseconds[STAT_COUNT])
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < STAT_COUNT; i++) milliseconds[i] = lastFrameTotals[i];
+}
+
+void FrameStats::Report()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    double seconds = (Now() - lastReport) / 1000.0;
+    printf("%.1f fps", seconds > 0 ? frames / seconds : 0.0);
+    for (int i = 0; i < STAT_COUNT; i++) {
+        const Entry& entry = entries[i];
+        if (entry.samples == 0) continue;
+        printf(" | %s %.3f/%.3f/%.3f", statNames[i], entry.min, entry.total / entry.samples, entry.max);
+    }
+    printf(" (ms min/avg/max)\n");
+
+    // Per phase and frame, misses per thousand instructions
+    for (int i = 0; i < STAT_COUNT; i++) {
+        const Entry& entry = entries[i];
+        if (entry.counterSamples == 0) continue;
+        const uint64_t* values = entry.counters.values;
+        double instructions = (double)values[COUNTER_INSTRUCTIONS];
+        printf("  %-8s", statNames[i]);
+        if (HardwareCounters::Available(COUNTER_CYCLES)) printf(" %9.0f cycles", (double)values[COUNTER_CYCLES] / entry.counterSamples);
+        if (HardwareCounters::Available(COUNTER_INSTRUCTIONS)) {
+            printf(" %9.0f instructions", instructions / entry.counterSamples);
+            if (HardwareCounters::Available(COUNTER_CYCLES) && values[COUNTER_CYCLES] > 0) {
+                printf(" %5.2f ipc", instructions / (double)values[COUNTER_CYCLES]);
+            }
+        }
+        for (int c = COUNTER_L1D_MISSES; c < COUNTER_COUNT; c++) {
+            if (HardwareCounters::Available((HardwareCounter)c) == false) continue;
+            if (HardwareCounters::Available(COUNTER_INSTRUCTIONS) && instructions > 0) {
+                printf(" | %s %.2f/ki", HardwareCounters::Name((HardwareCounter)c), values[c] * 1000.0 / instructions);
+            }
+            else {
+                printf(" | %s %.0f", HardwareCounters::Name((HardwareCounter)c), (double)values[c] / entry.counterSamples);
+            }
+        }
+        printf("\n");
+    }
+}
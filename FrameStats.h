@@ -0,0 +1,90 @@
+#pragma once
+
+#include <SDL.h>
+
+#include "HardwareCounters.h"
+
+#include <mutex>
+
+enum StatPhase {
+    // Simulation thread
+    STAT_INPUT, STAT_UPDATE, STAT_RENDER_SUBMIT, STAT_PACING_WAIT,
+    // Render thread, CPU side
+    STAT_DRAW, STAT_SWAP, STAT_PRESENT_INTERVAL,
+    // Render passes measured on the GPU
+    STAT_GPU_TILES, STAT_GPU_SPRITES, STAT_GPU_PARTICLES, STAT_GPU_TEXT,
+    STAT_COUNT
+};
+
+// Running min/avg/max per phase in milliseconds, reset every time it is reported.
+class FrameStats {
+public:
+
+    bool printEnabled = false;
+    float reportInterval = 1.0f;
+
+    // Time to first frame is measured from MarkStart to the first MarkFrameShown
+    void MarkStart();
+    void MarkFrameShown();
+
+    void Record(StatPhase phase, double milliseconds);
+    // CPU counters over one timed scope, with --counters
+    void RecordCounters(StatPhase phase, const CounterSample& before, const CounterSample& after);
+    void EndFrame();
+    void Report();
+
+    // Totals per phase of the frame EndFrame last closed
+    void LastFrame(double milliseconds[STAT_COUNT]);
+
+    static double Now();
+    static const char* Name(StatPhase phase);
+
+private:
+
+    struct Entry {
+        double total = 0;
+        double min = 0;
+        double max = 0;
+        int samples = 0;
+        CounterSample counters = {};
+        int counterSamples = 0;
+    };
+
+    Entry entries[STAT_COUNT];
+    double frameTotals[STAT_COUNT] = {};
+    double lastFrameTotals[STAT_COUNT] = {};
+    int frames = 0;
+    double lastReport = 0;
+    double startTime = 0;
+    bool firstFrameShown = false;
+    std::mutex mutex;
+};
+
+extern FrameStats frameStats;
+
+// Times the enclosing block into frameStats, and counts it when counters are on.
+// Counters are read outside the timed span so the system calls don't show in it.
+class StatScope {
+public:
+    StatScope(StatPhase phase) : phase(phase), counters(HardwareCounters::ForThread())
+    {
+        if (counters != NULL) counters->Read(&startCounters);
+        start = FrameStats::Now();
+    }
+
+    ~StatScope()
+    {
+        frameStats.Record(phase, FrameStats::Now() - start);
+        if (counters != NULL) {
+            CounterSample end;
+            counters->Read(&end);
+            frameStats.RecordCounters(phase, startCounters, end);
+        }
+    }
+
+private:
+    StatPhase phase;
+    HardwareCounters* counters;
+    CounterSample startCounters;
+    double start;
+};
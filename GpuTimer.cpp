@@ -0,0 +1,87 @@
+#include "GpuTimer.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const StatPhase passStats[GPU_PASS_COUNT] = { STAT_GPU_TILES, STAT_GPU_SPRITES, STAT_GPU_PARTICLES, STAT_GPU_TEXT };
+
+void GpuTimer::Init()
+{
+    int major = 0, minor = 0;
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (version != NULL) sscanf(version, "%d.%d", &major, &minor);
+
+    supported = major > 3 || (major == 3 && minor >= 3) || SDL_GL_ExtensionSupported("GL_ARB_timer_query");
+    if (supported == false) {
+        printf("GPU timer queries not supported, GPU timings disabled\n");
+        return;
+    }
+
+    // Software rasterizers bin draws and only run them on a flush, which would land
+    // outside the query brackets and leave every pass at zero
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    flushPasses = renderer != NULL && (strstr(renderer, "llvmpipe") != NULL || strstr(renderer, "softpipe") != NULL);
+
+    glGenQueries(GPU_TIMER_LATENCY * GPU_PASS_COUNT, &queries[0][0]);
+    memset(issued, 0, sizeof(issued));
+    frame = 0;
+    results = 0;
+    nonzeroResults = 0;
+}
+
+void GpuTimer::Cleanup()
+{
+    if (supported == false) return;
+    glDeleteQueries(GPU_TIMER_LATENCY * GPU_PASS_COUNT, &queries[0][0]);
+    supported = false;
+}
+
+void GpuTimer::Begin(GpuPass pass)
+{
+    if (supported == false) return;
+    // Work issued before the pass is run first, so it isn't counted in it
+    if (flushPasses) glFlush();
+    glBeginQuery(GL_TIME_ELAPSED, queries[frame][pass]);
+}
+
+void GpuTimer::End(GpuPass pass)
+{
+    if (supported == false) return;
+    // The first flush runs the pass, the second the end of the query right after it
+    if (flushPasses) glFlush();
+    glEndQuery(GL_TIME_ELAPSED);
+    if (flushPasses) glFlush();
+    issued[frame][pass] = true;
+}
+
+void GpuTimer::EndFrame()
+{
+    if (supported == false) return;
+
+    frame = (frame + 1) % GPU_TIMER_LATENCY;
+
+    // The slot we are about to reuse was issued GPU_TIMER_LATENCY - 1 frames ago
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        if (issued[frame][pass] == false) continue;
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[frame][pass], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[frame][pass], GL_QUERY_RESULT, &nanoseconds);
+            lastMilliseconds[pass] = (double)nanoseconds / 1000000.0;
+            results++;
+            if (nanoseconds > 0) nonzeroResults++;
+            // On a software rasterizer zeros may mean not measured rather than free, they
+            // aren't reported until it has measured something
+            if (flushPasses == false || nonzeroResults > 0) frameStats.Record(passStats[pass], lastMilliseconds[pass]);
+        }
+        // Still not done after several frames, drop it rather than wait
+        issued[frame][pass] = false;
+    }
+
+    if (flushPasses && results >= GPU_TIMER_EMPTY_RESULTS && nonzeroResults == 0) {
+        printf("GPU timer queries return nothing on this driver, GPU timings disabled\n");
+        Cleanup();
+    }
+}
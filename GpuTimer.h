@@ -0,0 +1,46 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include "FrameStats.h"
+
+// GL_TIME_ELAPSED queries around render passes. Results are read back
+// GPU_TIMER_LATENCY frames later so checking them never stalls the pipeline.
+#define GPU_TIMER_LATENCY 4
+// A software rasterizer whose first GPU_TIMER_EMPTY_RESULTS results were all zero isn't
+// timing the passes even with the flushes, its timings are turned off
+#define GPU_TIMER_EMPTY_RESULTS 256
+
+enum GpuPass { GPU_PASS_TILES, GPU_PASS_SPRITES, GPU_PASS_PARTICLES, GPU_PASS_TEXT, GPU_PASS_COUNT };
+
+class GpuTimer {
+public:
+
+    bool supported = false;
+    // glFlush around each pass, for drivers that only rasterize on a flush
+    bool flushPasses = false;
+
+    // Most recent result for each pass, in milliseconds
+    double lastMilliseconds[GPU_PASS_COUNT] = {};
+
+    // Needs a current GL context
+    void Init();
+    void Cleanup();
+
+    void Begin(GpuPass pass);
+    void End(GpuPass pass);
+    void EndFrame();
+
+private:
+
+    GLuint queries[GPU_TIMER_LATENCY][GPU_PASS_COUNT];
+    bool issued[GPU_TIMER_LATENCY][GPU_PASS_COUNT];
+    int frame = 0;
+    int results = 0;
+    int nonzeroResults = 0;
+};
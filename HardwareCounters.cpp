@@ -0,0 +1,154 @@
+#include "HardwareCounters.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+bool HardwareCounters::enabled = false;
+
+static const char* counterNames[COUNTER_COUNT] = { "cycles", "instructions", "l1d misses", "llc misses", "branch misses" };
+
+// Bit per counter some thread managed to open
+static std::atomic<uint32_t> availableMask(0);
+static std::atomic<bool> reportedUnavailable(false);
+
+static void ReportUnavailable(const char* reason)
+{
+    if (reportedUnavailable.exchange(true) == false) printf("Hardware counters unavailable: %s\n", reason);
+}
+
+const char* HardwareCounters::Name(HardwareCounter counter)
+{
+    return counterNames[counter];
+}
+
+bool HardwareCounters::Available(HardwareCounter counter)
+{
+    return (availableMask.load(std::memory_order_relaxed) & (1u << counter)) != 0;
+}
+
+HardwareCounters* HardwareCounters::ForThread()
+{
+    if (enabled == false) return NULL;
+    static thread_local HardwareCounters counters;
+    return counters.opened > 0 ? &counters : NULL;
+}
+
+#ifdef __linux__
+
+struct CounterEvent {
+    uint32_t type;
+    uint64_t config;
+};
+
+static const CounterEvent counterEvents[COUNTER_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static int OpenEvent(const CounterEvent& event, int group)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    // The group starts once every member is in
+    attr.disabled = group == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+HardwareCounters::HardwareCounters()
+{
+    int leader = -1;
+    int leaderError = 0;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        fds[i] = -1;
+        slots[i] = -1;
+
+        int fd = OpenEvent(counterEvents[i], leader);
+        if (fd == -1) {
+            if (leader == -1 && leaderError == 0) leaderError = errno;
+            continue;
+        }
+        if (leader == -1) leader = fd;
+        fds[i] = fd;
+        slots[i] = opened++;
+        availableMask.fetch_or(1u << i, std::memory_order_relaxed);
+    }
+
+    if (opened == 0) {
+        char reason[160];
+        if (leaderError == EACCES || leaderError == EPERM) {
+            snprintf(reason, sizeof(reason), "%s, check /proc/sys/kernel/perf_event_paranoid", strerror(leaderError));
+        }
+        else {
+            snprintf(reason, sizeof(reason), "%s, probably no PMU in this VM or container", strerror(leaderError));
+        }
+        ReportUnavailable(reason);
+        return;
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+HardwareCounters::~HardwareCounters()
+{
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (fds[i] != -1) close(fds[i]);
+    }
+}
+
+void HardwareCounters::Read(CounterSample* sample)
+{
+    memset(sample, 0, sizeof(*sample));
+
+    // nr, time enabled, time running, then one value per member in the order opened
+    uint64_t data[3 + COUNTER_COUNT];
+    int leader = -1;
+    for (int i = 0; i < COUNTER_COUNT && leader == -1; i++) leader = fds[i];
+    ssize_t size = read(leader, data, sizeof(data));
+    if (size < (ssize_t)(3 * sizeof(uint64_t)) || data[0] != (uint64_t)opened) return;
+
+    double scale = data[2] > 0 && data[2] < data[1] ? (double)data[1] / (double)data[2] : 1.0;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (slots[i] >= 0) sample->values[i] = (uint64_t)((double)data[3 + slots[i]] * scale);
+    }
+}
+
+#else
+
+HardwareCounters::HardwareCounters()
+{
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        fds[i] = -1;
+        slots[i] = -1;
+    }
+    ReportUnavailable("perf_event_open is only on Linux");
+}
+
+HardwareCounters::~HardwareCounters()
+{
+}
+
+void HardwareCounters::Read(CounterSample* sample)
+{
+    memset(sample, 0, sizeof(*sample));
+}
+
+#endif
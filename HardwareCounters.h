@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+enum HardwareCounter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT
+};
+
+struct CounterSample {
+    uint64_t values[COUNTER_COUNT];
+};
+
+// CPU counters of the calling thread through perf_event_open, Linux only. User space
+// only, so it works with the usual perf_event_paranoid of 2. Counters the CPU or a
+// container doesn't offer are left out, and when none are there at all ForThread
+// returns NULL and the reason is printed once. Each Read is a system call, so only
+// whole phases are measured, never single entities.
+class HardwareCounters {
+public:
+
+    // Set by --counters before any thread starts counting
+    static bool enabled;
+
+    // Opened the first time a thread asks, NULL when disabled or unavailable
+    static HardwareCounters* ForThread();
+
+    // Whether any thread could open the counter
+    static bool Available(HardwareCounter counter);
+    static const char* Name(HardwareCounter counter);
+
+    // Totals since the thread opened its counters. Counters the kernel had to
+    // multiplex are scaled up to the time they were enabled.
+    void Read(CounterSample* sample);
+
+    ~HardwareCounters();
+
+private:
+
+    int fds[COUNTER_COUNT];
+    // Position in the group read, -1 if not opened
+    int slots[COUNTER_COUNT];
+    int opened = 0;
+
+    HardwareCounters();
+    HardwareCounters(const HardwareCounters&);
+    HardwareCounters& operator=(const HardwareCounters&);
+};
+
+// Adds after - before into totals, counter by counter. Scaled totals can step back
+// a little when multiplexing changes, that counts as nothing.
+inline void AddCounterDelta(const CounterSample& before, const CounterSample& after, CounterSample* totals)
+{
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (after.values[i] > before.values[i]) totals->values[i] += after.values[i] - before.values[i];
+    }
+}
@@ -0,0 +1,46 @@
+#include "InputRecording.h"
+
+#include <cstdio>
+#include <cstring>
+
+bool InputRecording::Read(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    // The header's counts are checked against what the file holds before anything is sized from them
+    long fileSize = -1;
+    if (fseek(file, 0, SEEK_END) == 0) fileSize = ftell(file);
+    rewind(file);
+
+    InputRecordingHeader header;
+    bool valid = fileSize >= (long)sizeof(header) && fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, "EINP", 4) == 0 && header.version == INPUT_RECORDING_VERSION &&
+        header.levelLength < 4096 &&
+        (uint64_t)header.stepCount + header.levelLength == (uint64_t)fileSize - sizeof(header);
+    if (valid) {
+        level.resize(header.levelLength);
+        steps.resize(header.stepCount);
+        valid = (header.levelLength == 0 || fread(&level[0], 1, header.levelLength, file) == header.levelLength) &&
+            (header.stepCount == 0 || fread(steps.data(), 1, header.stepCount, file) == header.stepCount);
+    }
+    fclose(file);
+    return valid;
+}
+
+bool InputRecording::Write(const char* path) const
+{
+    InputRecordingHeader header = {};
+    memcpy(header.magic, "EINP", 4);
+    header.version = INPUT_RECORDING_VERSION;
+    header.stepCount = (uint32_t)steps.size();
+    header.levelLength = (uint32_t)level.size();
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) return false;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(level.data(), 1, level.size(), file) == level.size() &&
+        fwrite(steps.data(), 1, steps.size(), file) == steps.size();
+    fclose(file);
+    return written;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// What the player did on each fixed step of a session, written by --record-input and
+// replayed by --perf-gate. One byte of INPUT_ flags per step after the header.
+#define INPUT_RECORDING_VERSION 1
+
+enum InputFlags {
+    INPUT_LEFT = 1,
+    INPUT_RIGHT = 2,
+    INPUT_JUMP = 4,
+    // Last step of a frame. Streaming runs before a frame's steps and the rules after them.
+    INPUT_FRAME_END = 8
+};
+
+struct InputRecordingHeader {
+    char magic[4];  // "EINP"
+    uint32_t version;
+    uint32_t stepCount;
+    // Followed by this many bytes of level path, empty when the game picked its default
+    uint32_t levelLength;
+};
+
+static_assert(sizeof(InputRecordingHeader) == 16, "InputRecordingHeader layout changed");
+
+struct InputRecording {
+    std::string level;
+    std::vector<uint8_t> steps;
+
+    bool Read(const char* path);
+    bool Write(const char* path) const;
+};
@@ -0,0 +1,182 @@
+#include "Level.h"
+#include "Entity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+const LevelSpawn* Level::FindSpawn(LevelSpawnType type) const
+{
+    for (uint32_t i = 0; i < spawnCount; i++) {
+        if (spawns[i].type == type) return &spawns[i];
+    }
+    return NULL;
+}
+
+// Covers unit cells given by their centers with few rectangles: every row is cut
+// into runs of adjacent cells, and a run exactly on top of a run from the row
+// below extends that rectangle upwards instead of starting a new one.
+static void MergeCells(const std::vector<LevelTile>& cells, size_t first, size_t count, std::vector<LevelRect>* rects)
+{
+    if (count == 0) return;
+
+    std::vector<LevelTile> sorted(cells.begin() + first, cells.begin() + first + count);
+    std::sort(sorted.begin(), sorted.end(), [](const LevelTile& a, const LevelTile& b) {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+    });
+
+    // Rects that reached the previous row, by their left and right edge
+    std::map<std::pair<float, float>, size_t> open, next;
+
+    size_t i = 0;
+    while (i < sorted.size()) {
+        float y = sorted[i].y;
+        next.clear();
+
+        while (i < sorted.size() && sorted[i].y == y) {
+            float left = sorted[i].x - 0.5f;
+            float right = sorted[i].x + 0.5f;
+            i++;
+            // Duplicates from stacked layers are skipped, neighbors extend the run
+            while (i < sorted.size() && sorted[i].y == y && sorted[i].x - 0.5f <= right + 0.001f) {
+                right = std::max(right, sorted[i].x + 0.5f);
+                i++;
+            }
+
+            std::pair<float, float> key(left, right);
+            auto below = open.find(key);
+            if (below != open.end() && fabsf((*rects)[below->second].top - (y - 0.5f)) < 0.001f) {
+                (*rects)[below->second].top = y + 0.5f;
+                next[key] = below->second;
+            }
+            else {
+                LevelRect rect = { left, y - 0.5f, right, y + 0.5f };
+                next[key] = rects->size();
+                rects->push_back(rect);
+            }
+        }
+        open.swap(next);
+    }
+}
+
+void LevelBuilder::Build(Level* level)
+{
+    float left = 0, right = 0, bottom = 0, top = 0;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (i == 0 || tiles[i].x - 0.5f < left) left = tiles[i].x - 0.5f;
+        if (i == 0 || tiles[i].x + 0.5f > right) right = tiles[i].x + 0.5f;
+        if (i == 0 || tiles[i].y - 0.5f < bottom) bottom = tiles[i].y - 0.5f;
+        if (i == 0 || tiles[i].y + 0.5f > top) top = tiles[i].y + 0.5f;
+    }
+
+    auto chunkOf = [left](float x) { return (int)floorf((x - left) / LEVEL_CHUNK_WIDTH); };
+
+    // Group everything by chunk, keeping the player spawn separate from chunks
+    std::stable_sort(tiles.begin(), tiles.end(), [&](const LevelTile& a, const LevelTile& b) {
+        return chunkOf(a.x) < chunkOf(b.x);
+    });
+    std::stable_sort(spawns.begin(), spawns.end(), [&](const LevelSpawn& a, const LevelSpawn& b) {
+        return chunkOf(a.x) < chunkOf(b.x);
+    });
+    if (solidsGiven == false) solids = tiles;
+    std::stable_sort(solids.begin(), solids.end(), [&](const LevelTile& a, const LevelTile& b) {
+        return chunkOf(a.x) < chunkOf(b.x);
+    });
+
+    int chunkCount = (int)ceilf((right - left) / LEVEL_CHUNK_WIDTH);
+    if (chunkCount < 1) chunkCount = 1;
+
+    chunks.assign(chunkCount, LevelChunk());
+    rects.clear();
+    uint32_t tile = 0, solid = 0, spawn = 0;
+    for (int i = 0; i < chunkCount; i++) {
+        LevelChunk& chunk = chunks[i];
+        chunk.left = left + i * LEVEL_CHUNK_WIDTH;
+        chunk.right = chunk.left + LEVEL_CHUNK_WIDTH;
+
+        // Anything past the last boundary goes in the last chunk
+        bool last = i == chunkCount - 1;
+        chunk.firstTile = tile;
+        while (tile < tiles.size() && (last || chunkOf(tiles[tile].x) <= i)) tile++;
+        chunk.tileCount = tile - chunk.firstTile;
+
+        // Rects never cross a chunk boundary so each chunk can stream its own
+        uint32_t firstSolid = solid;
+        while (solid < solids.size() && (last || chunkOf(solids[solid].x) <= i)) solid++;
+        chunk.firstRect = (uint32_t)rects.size();
+        MergeCells(solids, firstSolid, solid - firstSolid, &rects);
+        chunk.rectCount = (uint32_t)rects.size() - chunk.firstRect;
+
+        chunk.firstSpawn = spawn;
+        while (spawn < spawns.size() && (last || chunkOf(spawns[spawn].x) <= i)) spawn++;
+        chunk.spawnCount = spawn - chunk.firstSpawn;
+    }
+
+    level->tiles = tiles.data();
+    level->tileCount = (uint32_t)tiles.size();
+    level->rects = rects.data();
+    level->rectCount = (uint32_t)rects.size();
+    level->spawns = spawns.data();
+    level->spawnCount = (uint32_t)spawns.size();
+    level->chunks = chunks.data();
+    level->chunkCount = (uint32_t)chunks.size();
+    level->left = left;
+    level->right = right;
+    level->bottom = bottom;
+    level->top = top;
+}
+
+LevelSpawn DefaultPlayerSpawn(float x, float y)
+{
+    LevelSpawn spawn = {};
+    spawn.type = SPAWN_PLAYER;
+    spawn.x = x;
+    spawn.y = y;
+    spawn.width = 0.7f;
+    spawn.height = 0.8f;
+    spawn.speed = 1.5f;
+    spawn.jumpPower = 6.0f;
+    return spawn;
+}
+
+LevelSpawn DefaultEnemySpawn(float x, float y, int aiType)
+{
+    LevelSpawn spawn = {};
+    spawn.type = SPAWN_ENEMY;
+    spawn.aiType = (uint8_t)aiType;
+    spawn.x = x;
+    spawn.y = y;
+    spawn.width = 0.8f;
+    spawn.height = 0.65f;
+    spawn.speed = 1.0f;
+
+    switch (aiType) {
+    case WALKER:
+        spawn.aiState = WALKING;
+        spawn.movementX = -1.0f;
+        break;
+    case JUMPER:
+        spawn.aiState = JUMPING;
+        spawn.jumpPower = 3.0f;
+        break;
+    case WAITANDGO:
+        spawn.aiState = IDLE;
+        break;
+    }
+    return spawn;
+}
+
+void BuildDefaultLevel(LevelBuilder* builder)
+{
+    for (int i = 0; i < 10; i++) {
+        builder->tiles.push_back({ -4.5f + i, -3.25f });
+    }
+    builder->tiles.push_back({ -2.0f, -2.25f });
+    builder->tiles.push_back({ 2.0f, -2.25f });
+    builder->tiles.push_back({ 3.0f, -2.25f });
+
+    builder->spawns.push_back(DefaultPlayerSpawn(-4.5f, -2.25f));
+    builder->spawns.push_back(DefaultEnemySpawn(1.0f, -1.0f, WALKER));
+    builder->spawns.push_back(DefaultEnemySpawn(3.0f, -1.0f, JUMPER));
+    builder->spawns.push_back(DefaultEnemySpawn(2.0f, -1.0f, WAITANDGO));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Plain structs so a level can be read straight from a file. Chunks are vertical
+// strips of the level, each owning a contiguous range of tiles, rects and spawns.
+// Tiles are only drawn, collision uses the rects, which cover runs of solid tiles.
+
+#define LEVEL_CHUNK_WIDTH 8.0f
+
+enum LevelSpawnType { SPAWN_PLAYER = 0, SPAWN_ENEMY = 1 };
+
+struct LevelTile {
+    // Center of a 1x1 tile
+    float x, y;
+};
+
+struct LevelRect {
+    float left, bottom, right, top;
+};
+
+struct LevelSpawn {
+    uint8_t type;
+    uint8_t aiType;
+    uint8_t aiState;
+    uint8_t reserved;
+    float x, y;
+    float width, height;
+    float speed;
+    float jumpPower;
+    float movementX;
+};
+
+struct LevelChunk {
+    float left, right;
+    uint32_t firstTile, tileCount;
+    uint32_t firstRect, rectCount;
+    uint32_t firstSpawn, spawnCount;
+};
+
+struct Level {
+    const LevelTile* tiles = NULL;
+    const LevelRect* rects = NULL;
+    const LevelSpawn* spawns = NULL;
+    const LevelChunk* chunks = NULL;
+    uint32_t tileCount = 0;
+    uint32_t rectCount = 0;
+    uint32_t spawnCount = 0;
+    uint32_t chunkCount = 0;
+
+    float left = 0, bottom = 0, right = 0, top = 0;
+
+    const LevelSpawn* FindSpawn(LevelSpawnType type) const;
+};
+
+// Builds chunks and collision rects for a level given as loose tiles and spawns,
+// storage owns the arrays
+struct LevelBuilder {
+    std::vector<LevelTile> tiles;
+    // Cells that block movement, every tile unless solidsGiven is set
+    std::vector<LevelTile> solids;
+    // Set when solids was filled in, even if it came out empty
+    bool solidsGiven = false;
+    std::vector<LevelSpawn> spawns;
+    std::vector<LevelRect> rects;
+    std::vector<LevelChunk> chunks;
+
+    void Build(Level* level);
+};
+
+// Spawn records with the parameters the original hand placed entities used
+LevelSpawn DefaultPlayerSpawn(float x, float y);
+LevelSpawn DefaultEnemySpawn(float x, float y, int aiType);
+
+// The original hand placed level
+void BuildDefaultLevel(LevelBuilder* builder);
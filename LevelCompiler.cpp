@@ -0,0 +1,415 @@
+#include "LevelCompiler.h"
+#include "LevelFile.h"
+#include "Entity.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON for Tiled maps. Arrays of plain numbers, like tile layer data,
+// are kept as doubles rather than one value each since they can be huge.
+struct JsonValue {
+    enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+    Type type = JSON_NULL;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<double> numbers;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* Get(const char* key) const
+    {
+        for (const auto& member : members) {
+            if (member.first == key) return &member.second;
+        }
+        return NULL;
+    }
+
+    double Number(const char* key, double fallback) const
+    {
+        const JsonValue* value = Get(key);
+        return value != NULL && value->type == JSON_NUMBER ? value->number : fallback;
+    }
+
+    std::string String(const char* key) const
+    {
+        const JsonValue* value = Get(key);
+        return value != NULL && value->type == JSON_STRING ? value->text : std::string();
+    }
+};
+
+class JsonParser {
+public:
+
+    JsonParser(const char* text, size_t length) : p(text), end(text + length) {}
+
+    bool Parse(JsonValue* value)
+    {
+        if (ParseValue(value, 0) == false) return false;
+        SkipSpace();
+        return p == end;
+    }
+
+    size_t Offset(const char* start) const { return p - start; }
+
+private:
+
+    const char* p;
+    const char* end;
+
+    void SkipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+
+    bool Match(const char* word)
+    {
+        size_t length = strlen(word);
+        if ((size_t)(end - p) < length || memcmp(p, word, length) != 0) return false;
+        p += length;
+        return true;
+    }
+
+    bool ParseValue(JsonValue* value, int depth)
+    {
+        if (depth > 64) return false;
+        SkipSpace();
+        if (p == end) return false;
+
+        switch (*p) {
+        case '{': return ParseObject(value, depth);
+        case '[': return ParseArray(value, depth);
+        case '"':
+            value->type = JsonValue::JSON_STRING;
+            return ParseString(&value->text);
+        case 't':
+            value->type = JsonValue::JSON_BOOL;
+            value->boolean = true;
+            return Match("true");
+        case 'f':
+            value->type = JsonValue::JSON_BOOL;
+            value->boolean = false;
+            return Match("false");
+        case 'n':
+            value->type = JsonValue::JSON_NULL;
+            return Match("null");
+        default:
+            value->type = JsonValue::JSON_NUMBER;
+            return ParseNumber(&value->number);
+        }
+    }
+
+    bool ParseNumber(double* number)
+    {
+        // The text is not null terminated, copy the token out for strtod
+        char token[64];
+        size_t length = 0;
+        while (p + length < end && length < sizeof(token) - 1 && strchr("+-0123456789.eE", p[length]) != NULL) length++;
+        if (length == 0) return false;
+
+        memcpy(token, p, length);
+        token[length] = 0;
+        char* tokenEnd;
+        *number = strtod(token, &tokenEnd);
+        if (tokenEnd != token + length) return false;
+        p += length;
+        return true;
+    }
+
+    bool ParseString(std::string* text)
+    {
+        p++;
+        text->clear();
+        while (p < end && *p != '"') {
+            char c = *p++;
+            if (c != '\\') {
+                text->push_back(c);
+                continue;
+            }
+            if (p == end) return false;
+            char escape = *p++;
+            switch (escape) {
+            case 'n': text->push_back('\n'); break;
+            case 't': text->push_back('\t'); break;
+            case 'r': text->push_back('\r'); break;
+            case 'b': text->push_back('\b'); break;
+            case 'f': text->push_back('\f'); break;
+            case 'u': {
+                if (end - p < 4) return false;
+                unsigned code = (unsigned)strtoul(std::string(p, 4).c_str(), NULL, 16);
+                p += 4;
+                // Names in maps are plain ASCII, anything else is only kept as UTF-8 up to U+07FF
+                if (code < 0x80) text->push_back((char)code);
+                else {
+                    text->push_back((char)(0xC0 | ((code >> 6) & 0x1F)));
+                    text->push_back((char)(0x80 | (code & 0x3F)));
+                }
+                break;
+            }
+            default: text->push_back(escape); break;
+            }
+        }
+        if (p == end) return false;
+        p++;
+        return true;
+    }
+
+    bool ParseArray(JsonValue* value, int depth)
+    {
+        value->type = JsonValue::JSON_ARRAY;
+        p++;
+        SkipSpace();
+        if (p < end && *p == ']') {
+            p++;
+            return true;
+        }
+
+        while (true) {
+            JsonValue item;
+            if (ParseValue(&item, depth + 1) == false) return false;
+
+            if (item.type == JsonValue::JSON_NUMBER && value->items.empty()) {
+                value->numbers.push_back(item.number);
+            }
+            else {
+                // Mixed array, move the numbers seen so far over to items
+                for (double number : value->numbers) {
+                    JsonValue numberItem;
+                    numberItem.type = JsonValue::JSON_NUMBER;
+                    numberItem.number = number;
+                    value->items.push_back(numberItem);
+                }
+                value->numbers.clear();
+                value->items.push_back(std::move(item));
+            }
+
+            SkipSpace();
+            if (p == end) return false;
+            if (*p == ']') {
+                p++;
+                return true;
+            }
+            if (*p != ',') return false;
+            p++;
+        }
+    }
+
+    bool ParseObject(JsonValue* value, int depth)
+    {
+        value->type = JsonValue::JSON_OBJECT;
+        p++;
+        SkipSpace();
+        if (p < end && *p == '}') {
+            p++;
+            return true;
+        }
+
+        while (true) {
+            SkipSpace();
+            if (p == end || *p != '"') return false;
+
+            std::pair<std::string, JsonValue> member;
+            if (ParseString(&member.first) == false) return false;
+            SkipSpace();
+            if (p == end || *p != ':') return false;
+            p++;
+            if (ParseValue(&member.second, depth + 1) == false) return false;
+            value->members.push_back(std::move(member));
+
+            SkipSpace();
+            if (p == end) return false;
+            if (*p == '}') {
+                p++;
+                return true;
+            }
+            if (*p != ',') return false;
+            p++;
+        }
+    }
+};
+
+// Tiled keeps custom properties as a list of { name, type, value }
+static const JsonValue* FindProperty(const JsonValue& owner, const char* name)
+{
+    const JsonValue* properties = owner.Get("properties");
+    if (properties == NULL) return NULL;
+    for (const JsonValue& property : properties->items) {
+        if (property.String("name") == name) return property.Get("value");
+    }
+    return NULL;
+}
+
+static float NumberProperty(const JsonValue& owner, const char* name, float fallback)
+{
+    const JsonValue* value = FindProperty(owner, name);
+    return value != NULL && value->type == JsonValue::JSON_NUMBER ? (float)value->number : fallback;
+}
+
+static bool ParseAIType(const std::string& name, int* aiType)
+{
+    if (name == "walker") *aiType = WALKER;
+    else if (name == "waitandgo") *aiType = WAITANDGO;
+    else if (name == "jumper") *aiType = JUMPER;
+    else return false;
+    return true;
+}
+
+static bool ReadTextFile(const char* path, std::string* text)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    text->resize(size > 0 ? (size_t)size : 0);
+    bool read = size <= 0 || fread(&(*text)[0], 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    return read;
+}
+
+int CompileLevel(int argc, char* argv[])
+{
+    if (argc < 2) {
+        printf("usage: --compile-level map.json out.lvl\n");
+        return 1;
+    }
+    const char* mapPath = argv[0];
+    const char* outPath = argv[1];
+
+    std::string text;
+    if (ReadTextFile(mapPath, &text) == false) {
+        printf("Unable to read %s\n", mapPath);
+        return 1;
+    }
+
+    JsonValue map;
+    JsonParser parser(text.data(), text.size());
+    if (parser.Parse(&map) == false || map.type != JsonValue::JSON_OBJECT) {
+        printf("%s: invalid JSON near byte %zu\n", mapPath, parser.Offset(text.data()));
+        return 1;
+    }
+
+    int mapHeight = (int)map.Number("height", 0);
+    float tileWidth = (float)map.Number("tilewidth", 1);
+    float tileHeight = (float)map.Number("tileheight", 1);
+    const JsonValue* layers = map.Get("layers");
+    if (mapHeight <= 0 || tileWidth <= 0 || tileHeight <= 0 || layers == NULL) {
+        printf("%s: not a Tiled map\n", mapPath);
+        return 1;
+    }
+
+    // One world unit per tile. The bottom left corner of the map lands on
+    // originX/originY, which default to the corner of the original screen.
+    float originX = NumberProperty(map, "originX", -5.0f);
+    float originY = NumberProperty(map, "originY", -3.75f);
+
+    LevelBuilder builder;
+    int failures = 0;
+
+    for (const JsonValue& layer : layers->items) {
+        std::string type = layer.String("type");
+        std::string name = layer.String("name");
+
+        if (type == "tilelayer") {
+            // A map whose tile layers are all marked not solid has no solid cells at all
+            builder.solidsGiven = true;
+            const JsonValue* data = layer.Get("data");
+            if (data == NULL || data->type != JsonValue::JSON_ARRAY || layer.Get("chunks") != NULL) {
+                printf("%s: layer '%s' needs uncompressed CSV data, infinite maps are not supported\n", mapPath, name.c_str());
+                failures++;
+                continue;
+            }
+
+            const JsonValue* solidProperty = FindProperty(layer, "solid");
+            bool solid = solidProperty == NULL || solidProperty->type != JsonValue::JSON_BOOL || solidProperty->boolean;
+
+            int width = (int)layer.Number("width", map.Number("width", 0));
+            int height = (int)layer.Number("height", mapHeight);
+            int offsetX = (int)layer.Number("x", 0);
+            int offsetY = (int)layer.Number("y", 0);
+            if (width <= 0 || data->numbers.size() < (size_t)width * height) {
+                printf("%s: layer '%s' data doesn't match its size\n", mapPath, name.c_str());
+                failures++;
+                continue;
+            }
+
+            for (int row = 0; row < height; row++) {
+                for (int column = 0; column < width; column++) {
+                    // The top bits of a gid are flip flags
+                    uint32_t gid = (uint32_t)data->numbers[(size_t)row * width + column] & 0x1FFFFFFF;
+                    if (gid == 0) continue;
+
+                    LevelTile tile;
+                    tile.x = originX + offsetX + column + 0.5f;
+                    tile.y = originY + (mapHeight - 1 - (offsetY + row)) + 0.5f;
+                    builder.tiles.push_back(tile);
+                    if (solid) builder.solids.push_back(tile);
+                }
+            }
+        }
+        else if (type == "objectgroup") {
+            const JsonValue* objects = layer.Get("objects");
+            if (objects == NULL) continue;
+
+            for (const JsonValue& object : objects->items) {
+                // Tiled 1.9 renamed an object's type to class
+                std::string kind = object.String("type");
+                if (kind.empty()) kind = object.String("class");
+
+                float width = (float)object.Number("width", 0) / tileWidth;
+                float height = (float)object.Number("height", 0) / tileHeight;
+                float x = originX + (float)object.Number("x", 0) / tileWidth + width / 2.0f;
+                float y = originY + mapHeight - ((float)object.Number("y", 0) / tileHeight + height / 2.0f);
+
+                LevelSpawn spawn;
+                if (kind == "player") {
+                    spawn = DefaultPlayerSpawn(x, y);
+                }
+                else if (kind == "enemy") {
+                    int aiType = WALKER;
+                    const JsonValue* aiName = FindProperty(object, "aiType");
+                    if (aiName != NULL && ParseAIType(aiName->text, &aiType) == false) {
+                        printf("%s: enemy '%s' has unknown aiType '%s'\n", mapPath, object.String("name").c_str(), aiName->text.c_str());
+                        failures++;
+                        continue;
+                    }
+                    spawn = DefaultEnemySpawn(x, y, aiType);
+                    spawn.movementX = NumberProperty(object, "direction", spawn.movementX);
+                }
+                else {
+                    continue;
+                }
+
+                spawn.speed = NumberProperty(object, "speed", spawn.speed);
+                spawn.jumpPower = NumberProperty(object, "jumpPower", spawn.jumpPower);
+                spawn.width = NumberProperty(object, "width", spawn.width);
+                spawn.height = NumberProperty(object, "height", spawn.height);
+                builder.spawns.push_back(spawn);
+            }
+        }
+    }
+
+    if (failures > 0) return 1;
+
+    Level level;
+    builder.Build(&level);
+    if (level.FindSpawn(SPAWN_PLAYER) == NULL) {
+        printf("%s: no player object\n", mapPath);
+        return 1;
+    }
+
+    if (WriteLevelFile(outPath, level) == false) {
+        printf("Unable to write %s\n", outPath);
+        return 1;
+    }
+
+    printf("%s: %u tiles, %zu solid, merged into %u collision rects, %u spawns, %u chunks\n", outPath,
+        level.tileCount, builder.solids.size(), level.rectCount, level.spawnCount, level.chunkCount);
+    return 0;
+}
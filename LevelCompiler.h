@@ -0,0 +1,8 @@
+#pragma once
+
+// --compile-level map.json out.lvl
+// Converts a map saved by the Tiled editor as JSON into the runtime level format.
+// Every tile layer is drawn; layers with a "solid" property set to false are not
+// collided with. Objects typed or classed "player" or "enemy" become spawns and
+// take aiType, speed, jumpPower, width, height and direction from their properties.
+int CompileLevel(int argc, char* argv[]);
@@ -0,0 +1,143 @@
+#include "LevelFile.h"
+#include "AssetPack.h"
+#include "Entity.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static bool SectionFits(uint64_t offset, uint64_t count, size_t elementSize, size_t size)
+{
+    if (offset % LEVEL_FILE_ALIGNMENT != 0 || offset > size) return false;
+    return count <= (size - offset) / elementSize;
+}
+
+bool ParseLevelFile(const unsigned char* data, size_t size, Level* level)
+{
+    if (size < sizeof(LevelFileHeader)) return false;
+
+    const LevelFileHeader* header = (const LevelFileHeader*)data;
+    if (memcmp(header->magic, "LEVL", 4) != 0 || header->version != LEVEL_FILE_VERSION) return false;
+    if (header->chunkCount == 0) return false;
+
+    if (SectionFits(header->tileOffset, header->tileCount, sizeof(LevelTile), size) == false) return false;
+    if (SectionFits(header->rectOffset, header->rectCount, sizeof(LevelRect), size) == false) return false;
+    if (SectionFits(header->spawnOffset, header->spawnCount, sizeof(LevelSpawn), size) == false) return false;
+    if (SectionFits(header->chunkOffset, header->chunkCount, sizeof(LevelChunk), size) == false) return false;
+
+    const LevelSpawn* spawns = (const LevelSpawn*)(data + header->spawnOffset);
+    const LevelChunk* chunks = (const LevelChunk*)(data + header->chunkOffset);
+
+    // Only the small tables are checked, tiles are just floats and can't be out of range
+    for (uint32_t i = 0; i < header->chunkCount; i++) {
+        const LevelChunk& chunk = chunks[i];
+        if ((uint64_t)chunk.firstTile + chunk.tileCount > header->tileCount) return false;
+        if ((uint64_t)chunk.firstRect + chunk.rectCount > header->rectCount) return false;
+        if ((uint64_t)chunk.firstSpawn + chunk.spawnCount > header->spawnCount) return false;
+        if (chunk.right < chunk.left || (i > 0 && chunk.left < chunks[i - 1].right)) return false;
+    }
+    for (uint32_t i = 0; i < header->spawnCount; i++) {
+        const LevelSpawn& spawn = spawns[i];
+        if (spawn.type > SPAWN_ENEMY || spawn.aiType > JUMPER || spawn.aiState > JUMPING) return false;
+    }
+
+    level->tiles = (const LevelTile*)(data + header->tileOffset);
+    level->tileCount = header->tileCount;
+    level->rects = (const LevelRect*)(data + header->rectOffset);
+    level->rectCount = header->rectCount;
+    level->spawns = spawns;
+    level->spawnCount = header->spawnCount;
+    level->chunks = chunks;
+    level->chunkCount = header->chunkCount;
+    level->left = header->left;
+    level->bottom = header->bottom;
+    level->right = header->right;
+    level->top = header->top;
+    return true;
+}
+
+static uint64_t Align(uint64_t offset)
+{
+    return (offset + LEVEL_FILE_ALIGNMENT - 1) & ~(uint64_t)(LEVEL_FILE_ALIGNMENT - 1);
+}
+
+bool WriteLevelFile(const char* path, const Level& level)
+{
+    LevelFileHeader header = {};
+    memcpy(header.magic, "LEVL", 4);
+    header.version = LEVEL_FILE_VERSION;
+    header.tileCount = level.tileCount;
+    header.rectCount = level.rectCount;
+    header.spawnCount = level.spawnCount;
+    header.chunkCount = level.chunkCount;
+    header.left = level.left;
+    header.bottom = level.bottom;
+    header.right = level.right;
+    header.top = level.top;
+
+    header.tileOffset = Align(sizeof(LevelFileHeader));
+    header.rectOffset = Align(header.tileOffset + (uint64_t)level.tileCount * sizeof(LevelTile));
+    header.spawnOffset = Align(header.rectOffset + (uint64_t)level.rectCount * sizeof(LevelRect));
+    header.chunkOffset = Align(header.spawnOffset + (uint64_t)level.spawnCount * sizeof(LevelSpawn));
+    uint64_t fileSize = header.chunkOffset + (uint64_t)level.chunkCount * sizeof(LevelChunk);
+
+    std::vector<unsigned char> bytes((size_t)fileSize, 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    if (level.tileCount > 0) memcpy(bytes.data() + header.tileOffset, level.tiles, level.tileCount * sizeof(LevelTile));
+    if (level.rectCount > 0) memcpy(bytes.data() + header.rectOffset, level.rects, level.rectCount * sizeof(LevelRect));
+    if (level.spawnCount > 0) memcpy(bytes.data() + header.spawnOffset, level.spawns, level.spawnCount * sizeof(LevelSpawn));
+    memcpy(bytes.data() + header.chunkOffset, level.chunks, level.chunkCount * sizeof(LevelChunk));
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) return false;
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    fclose(file);
+    return written;
+}
+
+bool LevelFile::Open(const char* path)
+{
+    Close();
+
+    const unsigned char* data;
+    size_t size;
+    if (assetPack.Find(path, &data, &size) == false) {
+        if (file.Open(path) == false) return false;
+        data = file.data;
+        size = file.size;
+    }
+
+    if (ParseLevelFile(data, size, &level) == false) {
+        printf("%s is not a valid level file\n", path);
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void LevelFile::Close()
+{
+    file.Close();
+    level = Level();
+}
+
+int ExportLevel(int argc, char* argv[])
+{
+    if (argc < 1) {
+        printf("usage: --export-level out.lvl\n");
+        return 1;
+    }
+
+    LevelBuilder builder;
+    Level level;
+    BuildDefaultLevel(&builder);
+    builder.Build(&level);
+
+    if (WriteLevelFile(argv[0], level) == false) {
+        printf("Unable to write %s\n", argv[0]);
+        return 1;
+    }
+    printf("%s: %u tiles, %u collision rects, %u spawns, %u chunks\n", argv[0],
+        level.tileCount, level.rectCount, level.spawnCount, level.chunkCount);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Level.h"
+#include "MappedFile.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary level written by --export-level and --compile-level. The header is followed
+// by the tile, rect, spawn and chunk arrays exactly as Level uses them, each at a LEVEL_FILE_ALIGNMENT
+// offset, so a mapped file is used in place without parsing or copying.
+#define LEVEL_FILE_VERSION 2
+#define LEVEL_FILE_ALIGNMENT 16
+#define LEVEL_FILE_DEFAULT_NAME "level1.lvl"
+
+struct LevelFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t tileCount;
+    uint32_t rectCount;
+    uint32_t spawnCount;
+    uint32_t chunkCount;
+    float left, bottom, right, top;
+    uint64_t tileOffset;
+    uint64_t rectOffset;
+    uint64_t spawnOffset;
+    uint64_t chunkOffset;
+};
+
+// The arrays are stored as is, so their layout is part of the format
+static_assert(sizeof(LevelFileHeader) == 72, "LevelFileHeader layout changed");
+static_assert(sizeof(LevelTile) == 8 && sizeof(LevelRect) == 16 && sizeof(LevelSpawn) == 32 && sizeof(LevelChunk) == 32,
+    "Level struct layout changed, bump LEVEL_FILE_VERSION");
+
+// Checks the header and chunk table and points level into data
+bool ParseLevelFile(const unsigned char* data, size_t size, Level* level);
+
+bool WriteLevelFile(const char* path, const Level& level);
+
+// Keeps the bytes behind level alive. They come from the asset pack when the
+// level is in there, otherwise the loose file is mapped.
+class LevelFile {
+public:
+
+    Level level;
+
+    bool Open(const char* path);
+    void Close();
+
+private:
+
+    MappedFile file;
+};
+
+// --export-level out.lvl, writes the built in level
+int ExportLevel(int argc, char* argv[]);
@@ -0,0 +1,310 @@
+#include "LevelStreamer.h"
+#include "Trace.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+
+void LevelStreamer::Start(const Level* level, SpatialGrid* renderGrid, SpatialGrid* collisionGrid)
+{
+    this->level = level;
+    this->renderGrid = renderGrid;
+    this->collisionGrid = collisionGrid;
+
+    states.assign(level->chunkCount, CHUNK_UNLOADED);
+    loaded.assign(level->chunkCount, NULL);
+    resident.clear();
+    defeated.assign(level->spawnCount, false);
+
+    enemyCount = 0;
+    defeatedCount = 0;
+    for (uint32_t i = 0; i < level->spawnCount; i++) {
+        if (level->spawns[i].type == SPAWN_ENEMY) enemyCount++;
+    }
+
+    quit = false;
+    worker = std::thread(&LevelStreamer::WorkerMain, this);
+}
+
+void LevelStreamer::Stop()
+{
+    if (worker.joinable() == false) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    worker.join();
+
+    for (LoadedChunk* chunk : finished) delete chunk;
+    for (LoadedChunk* chunk : retired) delete chunk;
+    for (LoadedChunk* chunk : loaded) delete chunk;
+    requests.clear();
+    finished.clear();
+    retired.clear();
+    loaded.assign(loaded.size(), NULL);
+    states.assign(states.size(), CHUNK_UNLOADED);
+    resident.clear();
+    enemies.clear();
+}
+
+void LevelStreamer::WorkerMain()
+{
+    TRACE_THREAD_NAME("level streamer");
+    profiler.RegisterThread("level streamer");
+    ALLOC_TAG("level streaming");
+    std::vector<LoadedChunk*> garbage;
+    while (true) {
+        int index = -1;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return requests.empty() == false || retired.empty() == false || quit; });
+            if (quit) return;
+
+            garbage.swap(retired);
+            if (requests.empty() == false) {
+                index = requests.front();
+                requests.pop_front();
+            }
+        }
+
+        // Freeing a big chunk is not free either, keep it off the main thread
+        if (garbage.empty() == false) {
+            TRACE_SCOPE("free chunks");
+            for (LoadedChunk* chunk : garbage) delete chunk;
+            garbage.clear();
+        }
+
+        if (index == -1) continue;
+        TRACE_SCOPE("load chunk");
+        LoadedChunk* chunk = Load(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(chunk);
+        }
+        chunkFinished.notify_all();
+    }
+}
+
+LevelStreamer::LoadedChunk* LevelStreamer::Load(int index)
+{
+    const LevelChunk& source = level->chunks[index];
+
+    LoadedChunk* chunk = new LoadedChunk();
+    chunk->index = index;
+
+    chunk->tiles.resize(source.tileCount);
+    for (uint32_t i = 0; i < source.tileCount; i++) {
+        const LevelTile& tile = level->tiles[source.firstTile + i];
+        Entity& entity = chunk->tiles[i];
+        entity.entityType = PLATFORM;
+        entity.textureID = tileTexture;
+        entity.position = glm::vec3(tile.x, tile.y, 0.0f);
+    }
+
+    chunk->colliders.resize(source.rectCount);
+    for (uint32_t i = 0; i < source.rectCount; i++) {
+        const LevelRect& rect = level->rects[source.firstRect + i];
+        Entity& entity = chunk->colliders[i];
+        entity.entityType = PLATFORM;
+        entity.position = glm::vec3((rect.left + rect.right) / 2.0f, (rect.bottom + rect.top) / 2.0f, 0.0f);
+        entity.width = rect.right - rect.left;
+        entity.height = rect.top - rect.bottom;
+    }
+
+    chunk->enemies.reserve(source.spawnCount);
+    for (uint32_t i = 0; i < source.spawnCount; i++) {
+        uint32_t spawnIndex = source.firstSpawn + i;
+        const LevelSpawn& spawn = level->spawns[spawnIndex];
+        if (spawn.type != SPAWN_ENEMY) continue;
+
+        chunk->enemies.push_back(Entity());
+        Entity& entity = chunk->enemies.back();
+        entity.entityType = ENEMY;
+        entity.spawnIndex = (int)spawnIndex;
+        entity.aiType = (AIType)spawn.aiType;
+        entity.aiState = (AIState)spawn.aiState;
+        entity.streamedTexture = enemyTexture;
+        entity.acceleration = glm::vec3(0, -9.81f, 0);
+        entity.position = glm::vec3(spawn.x, spawn.y, 0.0f);
+        entity.movement = glm::vec3(spawn.movementX, 0, 0);
+        entity.width = spawn.width;
+        entity.height = spawn.height;
+        entity.speed = spawn.speed;
+        entity.jumpPower = spawn.jumpPower;
+    }
+    return chunk;
+}
+
+float LevelStreamer::DistanceTo(int index, float focusX) const
+{
+    const LevelChunk& chunk = level->chunks[index];
+    if (focusX < chunk.left) return chunk.left - focusX;
+    if (focusX > chunk.right) return focusX - chunk.right;
+    return 0.0f;
+}
+
+int LevelStreamer::FirstChunkEndingAfter(float x) const
+{
+    // Chunks are sorted strips, so a binary search finds the start of any range
+    int low = 0, high = (int)level->chunkCount;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (level->chunks[middle].right <= x) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+void LevelStreamer::Update(float focusX)
+{
+    TRACE_SCOPE("LevelStreamer::Update");
+    // Only allocates while chunks come and go
+    ALLOC_TAG("level streaming");
+    bool enemiesChanged = false;
+
+    // Request what came into range
+    newRequests.clear();
+    for (int i = FirstChunkEndingAfter(focusX - loadDistance); i < (int)level->chunkCount; i++) {
+        if (level->chunks[i].left > focusX + loadDistance) break;
+        if (states[i] != CHUNK_UNLOADED) continue;
+
+        states[i] = CHUNK_LOADING;
+        resident.push_back(i);
+        newRequests.push_back(i);
+    }
+
+    arrived.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int index : newRequests) requests.push_back(index);
+        arrived.swap(finished);
+    }
+    if (newRequests.empty() == false) wake.notify_one();
+
+    for (LoadedChunk* chunk : arrived) {
+        loaded[chunk->index] = chunk;
+        states[chunk->index] = CHUNK_ACTIVATING;
+    }
+
+    // Unload at most one chunk that went out of range, activate within the budget
+    bool unloaded = false;
+    int budget = activationBudget;
+    for (int r = 0; r < (int)resident.size(); r++) {
+        int i = resident[r];
+        if (states[i] == CHUNK_LOADING) continue;
+
+        if (DistanceTo(i, focusX) > unloadDistance) {
+            if (unloaded) continue;
+            if (states[i] == CHUNK_ACTIVE) enemiesChanged = true;
+            Unload(i);
+            resident[r] = resident.back();
+            resident.pop_back();
+            r--;
+            unloaded = true;
+        }
+        else if (states[i] == CHUNK_ACTIVATING && budget > 0 && Activate(loaded[i], &budget)) {
+            states[i] = CHUNK_ACTIVE;
+            enemiesChanged = true;
+        }
+    }
+
+    if (enemiesChanged) RebuildEnemies();
+    TRACE_COUNTER("resident chunks", resident.size());
+}
+
+void LevelStreamer::Prime(float focusX)
+{
+    int saved = activationBudget;
+    activationBudget = 1 << 30;
+
+    while (true) {
+        Update(focusX);
+
+        bool pending = false;
+        for (int index : resident) {
+            if (states[index] != CHUNK_ACTIVE) pending = true;
+        }
+        if (pending == false) break;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        chunkFinished.wait(lock, [this] { return finished.empty() == false; });
+    }
+
+    activationBudget = saved;
+}
+
+bool LevelStreamer::Activate(LoadedChunk* chunk, int* budget)
+{
+    int tileCount = (int)chunk->tiles.size();
+    int colliderCount = (int)chunk->colliders.size();
+    int total = tileCount + colliderCount + (int)chunk->enemies.size();
+
+    while (chunk->activated < total && *budget > 0) {
+        int n = chunk->activated;
+        if (n < tileCount) {
+            renderGrid->Insert(&chunk->tiles[n]);
+        }
+        else if (n < tileCount + colliderCount) {
+            collisionGrid->Insert(&chunk->colliders[n - tileCount]);
+        }
+        else {
+            Entity* enemy = &chunk->enemies[n - tileCount - colliderCount];
+            // Enemies already stomped stay gone when their chunk comes back
+            if (defeated[enemy->spawnIndex]) enemy->isActive = false;
+            else renderGrid->Insert(enemy);
+        }
+        chunk->activated++;
+        (*budget)--;
+    }
+    return chunk->activated == total;
+}
+
+void LevelStreamer::Unload(int index)
+{
+    LoadedChunk* chunk = loaded[index];
+    int tileCount = (int)chunk->tiles.size();
+    int colliderCount = (int)chunk->colliders.size();
+
+    for (int n = 0; n < chunk->activated; n++) {
+        if (n < tileCount) renderGrid->Remove(&chunk->tiles[n]);
+        else if (n < tileCount + colliderCount) collisionGrid->Remove(&chunk->colliders[n - tileCount]);
+        else renderGrid->Remove(&chunk->enemies[n - tileCount - colliderCount]);
+    }
+    renderGrid->Prune();
+    collisionGrid->Prune();
+
+    loaded[index] = NULL;
+    states[index] = CHUNK_UNLOADED;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired.push_back(chunk);
+    }
+    wake.notify_one();
+}
+
+void LevelStreamer::RebuildEnemies()
+{
+    enemies.clear();
+    for (int i : resident) {
+        if (states[i] != CHUNK_ACTIVE) continue;
+        for (Entity& enemy : loaded[i]->enemies) {
+            if (enemy.isActive) enemies.push_back(&enemy);
+        }
+    }
+}
+
+void LevelStreamer::MarkDefeated(Entity* enemy)
+{
+    if (enemy->spawnIndex < 0 || defeated[enemy->spawnIndex]) return;
+    defeated[enemy->spawnIndex] = true;
+    defeatedCount++;
+}
+
+int LevelStreamer::ActiveChunkCount() const
+{
+    int count = 0;
+    for (int index : resident) {
+        if (states[index] == CHUNK_ACTIVE) count++;
+    }
+    return count;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Level.h"
+#include "Entity.h"
+#include "SpatialGrid.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct StreamedTexture;
+
+// Keeps only the chunks near the focus point alive. Entities for a chunk are built
+// on a background thread, added to the grids a few at a time on the main thread,
+// and freed on the background thread again once the chunk is far enough away.
+class LevelStreamer {
+public:
+
+    // Chunks closer than this to the focus point are loaded...
+    float loadDistance = 12.0f;
+    // ...and unloaded once they are further than this, the gap stops thrashing at a boundary
+    float unloadDistance = 20.0f;
+    // Entities added to the grids per Update, spreads big chunks over several frames
+    int activationBudget = 256;
+
+    GLuint tileTexture = 0;
+    StreamedTexture* enemyTexture = NULL;
+
+    // Enemies of every active chunk, rebuilt when chunks come and go
+    std::vector<Entity*> enemies;
+
+    void Start(const Level* level, SpatialGrid* renderGrid, SpatialGrid* collisionGrid);
+    void Stop();
+
+    // Main thread, once per frame
+    void Update(float focusX);
+
+    // Loads everything around focusX before returning, for the first frame
+    void Prime(float focusX);
+
+    void MarkDefeated(Entity* enemy);
+    bool AllEnemiesDefeated() const { return defeatedCount == enemyCount; }
+
+    int ActiveChunkCount() const;
+
+private:
+
+    enum ChunkState { CHUNK_UNLOADED, CHUNK_LOADING, CHUNK_ACTIVATING, CHUNK_ACTIVE };
+
+    struct LoadedChunk {
+        int index;
+        // Drawn only
+        std::vector<Entity> tiles;
+        // Collided with only, one per level rect
+        std::vector<Entity> colliders;
+        std::vector<Entity> enemies;
+        // Entities added to the grids so far, in the order above
+        int activated = 0;
+    };
+
+    const Level* level = NULL;
+    SpatialGrid* renderGrid = NULL;
+    SpatialGrid* collisionGrid = NULL;
+
+    std::vector<ChunkState> states;
+    std::vector<LoadedChunk*> loaded;
+    // Every chunk that isn't CHUNK_UNLOADED, so Update never walks the whole level
+    std::vector<int> resident;
+    std::vector<bool> defeated;
+    int enemyCount = 0;
+    int defeatedCount = 0;
+
+    // Shared with the worker
+    std::deque<int> requests;
+    // Vectors swapped with the lists below rather than deques, so a frame with
+    // nothing to stream doesn't allocate
+    std::vector<LoadedChunk*> finished;
+    std::vector<LoadedChunk*> retired;
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable chunkFinished;
+    std::thread worker;
+
+    // Main thread scratch, kept to reuse their storage
+    std::vector<int> newRequests;
+    std::vector<LoadedChunk*> arrived;
+
+    void WorkerMain();
+    LoadedChunk* Load(int index);
+
+    float DistanceTo(int index, float focusX) const;
+    int FirstChunkEndingAfter(float x) const;
+    bool Activate(LoadedChunk* chunk, int* budget);
+    void Unload(int index);
+    void RebuildEnemies();
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+// Read-only view of a whole file. Pages are only read from disk when touched.
+class MappedFile {
+public:
+
+    const unsigned char* data = NULL;
+    size_t size = 0;
+
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+
+    bool Open(const char* path);
+    void Close();
+
+private:
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+    void* fileHandle = NULL;
+    void* mappingHandle = NULL;
+#endif
+};
@@ -0,0 +1,298 @@
+#include "Metrics.h"
+#include "FrameStats.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Metrics metrics;
+
+static const char* metricNames[METRIC_COUNT] = {
+    "fixed_steps", "entities_updated", "collision_tests", "contacts",
+    "sprites_submitted", "draw_calls", "state_changes", "bytes_uploaded",
+    "allocations", "bytes_allocated",
+};
+
+static size_t SharedMemorySize()
+{
+    return sizeof(MetricsShmHeader) + sizeof(MetricsRow) * METRICS_SHM_CAPACITY;
+}
+
+Metrics::Metrics()
+{
+    for (int i = 0; i < METRIC_COUNT; i++) counters[i].store(0, std::memory_order_relaxed);
+}
+
+const char* Metrics::Name(Metric metric)
+{
+    return metricNames[metric];
+}
+
+bool Metrics::OpenCsv(const char* path, int rowsPerFile)
+{
+    csvPath = path;
+    this->rowsPerFile = rowsPerFile > 0 ? rowsPerFile : 1;
+    return StartCsvFile();
+}
+
+bool Metrics::StartCsvFile()
+{
+    csv = fopen(csvPath.c_str(), "w");
+    if (csv == NULL) {
+        printf("Unable to write %s\n", csvPath.c_str());
+        return false;
+    }
+    // Rows go out in large writes rather than one per frame
+    setvbuf(csv, NULL, _IOFBF, 1 << 16);
+
+    fprintf(csv, "frame,time_s,frame_ms");
+    for (int i = 0; i < METRIC_COUNT; i++) fprintf(csv, ",%s", metricNames[i]);
+    fprintf(csv, "\n");
+    rowsInFile = 0;
+    return true;
+}
+
+void Metrics::WriteCsv(const MetricsRow& row)
+{
+    if (rowsInFile >= rowsPerFile) {
+        fclose(csv);
+        std::string previous = csvPath + ".1";
+        remove(previous.c_str());
+        rename(csvPath.c_str(), previous.c_str());
+        if (StartCsvFile() == false) {
+            csv = NULL;
+            return;
+        }
+    }
+
+    fprintf(csv, "%llu,%.4f,%.3f", (unsigned long long)row.frame, row.time, row.frameMilliseconds);
+    for (int i = 0; i < METRIC_COUNT; i++) fprintf(csv, ",%llu", (unsigned long long)row.values[i]);
+    fprintf(csv, "\n");
+    rowsInFile++;
+}
+
+#ifdef _WIN32
+
+static void* MapShared(const char* name, bool create, void** handle)
+{
+    std::string fullName = std::string("Local\\") + name;
+    HANDLE mapping;
+    if (create) {
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)SharedMemorySize(), fullName.c_str());
+    }
+    else {
+        mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, fullName.c_str());
+    }
+    if (mapping == NULL) return NULL;
+
+    void* view = MapViewOfFile(mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, SharedMemorySize());
+    if (view == NULL) {
+        CloseHandle(mapping);
+        return NULL;
+    }
+    *handle = mapping;
+    return view;
+}
+
+static void UnmapShared(void* view, void* handle, const char* name, bool owner)
+{
+    UnmapViewOfFile(view);
+    CloseHandle(handle);
+}
+
+#else
+
+static void* MapShared(const char* name, bool create, void** handle)
+{
+    std::string fullName = std::string("/") + name;
+    int file = shm_open(fullName.c_str(), create ? O_CREAT | O_RDWR : O_RDONLY, 0644);
+    if (file == -1) return NULL;
+
+    size_t size = SharedMemorySize();
+    if (create && ftruncate(file, (off_t)size) != 0) {
+        close(file);
+        shm_unlink(fullName.c_str());
+        return NULL;
+    }
+
+    struct stat info;
+    if (create == false && (fstat(file, &info) != 0 || (size_t)info.st_size < size)) {
+        close(file);
+        return NULL;
+    }
+
+    void* view = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (view == MAP_FAILED) {
+        if (create) shm_unlink(fullName.c_str());
+        return NULL;
+    }
+    *handle = NULL;
+    return view;
+}
+
+static void UnmapShared(void* view, void*, const char* name, bool owner)
+{
+    munmap(view, SharedMemorySize());
+    if (owner) shm_unlink((std::string("/") + name).c_str());
+}
+
+#endif
+
+bool Metrics::OpenSharedMemory(const char* name)
+{
+    void* handle = NULL;
+    void* view = MapShared(name, true, &handle);
+    if (view == NULL) {
+        printf("Unable to create shared memory %s\n", name);
+        return false;
+    }
+
+    shm = (MetricsShmHeader*)view;
+    shmRows = (MetricsRow*)(shm + 1);
+    shmName = name;
+#ifdef _WIN32
+    shmHandle = handle;
+#endif
+
+    // Readers only trust the block once the magic is there
+    shm->version = METRICS_SHM_VERSION;
+    shm->metricCount = METRIC_COUNT;
+    shm->capacity = METRICS_SHM_CAPACITY;
+    shm->rowSize = sizeof(MetricsRow);
+    shm->written.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        strncpy(shm->names[i], metricNames[i], METRICS_NAME_LENGTH - 1);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(shm->magic, "EMET", 4);
+    return true;
+}
+
+void Metrics::Close()
+{
+    if (csv != NULL) fclose(csv);
+    csv = NULL;
+
+    if (shm != NULL) {
+#ifdef _WIN32
+        UnmapShared(shm, shmHandle, shmName.c_str(), true);
+        shmHandle = NULL;
+#else
+        UnmapShared(shm, NULL, shmName.c_str(), true);
+#endif
+    }
+    shm = NULL;
+    shmRows = NULL;
+}
+
+void Metrics::EndFrame()
+{
+    double now = FrameStats::Now();
+    if (frame == 0) startTime = lastFrame = now;
+
+    MetricsRow row;
+    row.frame = frame++;
+    row.time = (now - startTime) / 1000.0;
+    row.frameMilliseconds = now - lastFrame;
+    lastFrame = now;
+
+    // Render thread counts land in whichever frame is open when they arrive
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        row.values[i] = counters[i].exchange(0, std::memory_order_relaxed);
+    }
+    last = row;
+
+    if (csv != NULL) WriteCsv(row);
+
+    if (shm != NULL) {
+        uint64_t index = shm->written.load(std::memory_order_relaxed);
+        shmRows[index % METRICS_SHM_CAPACITY] = row;
+        shm->written.store(index + 1, std::memory_order_release);
+    }
+}
+
+int WatchMetrics(int argc, char* argv[])
+{
+    if (argc < 1) {
+        printf("usage: --metrics-watch name\n");
+        return 1;
+    }
+    const char* name = argv[0];
+
+    void* handle = NULL;
+    const MetricsShmHeader* header = (const MetricsShmHeader*)MapShared(name, false, &handle);
+    if (header == NULL) {
+        printf("Nothing published as %s, start the game with --metrics-shm %s\n", name, name);
+        return 1;
+    }
+    if (memcmp(header->magic, "EMET", 4) != 0 || header->version != METRICS_SHM_VERSION ||
+        header->metricCount != METRIC_COUNT || header->rowSize != sizeof(MetricsRow)) {
+        printf("%s is from a different build\n", name);
+        UnmapShared((void*)header, handle, name, false);
+        return 1;
+    }
+    const MetricsRow* rows = (const MetricsRow*)(header + 1);
+    uint64_t capacity = header->capacity;
+
+    printf("%8s %9s %9s", "fps", "avg ms", "max ms");
+    for (int i = 0; i < METRIC_COUNT; i++) printf(" %17s", header->names[i]);
+    printf("\n%8s %9s %9s", "", "", "");
+    for (int i = 0; i < METRIC_COUNT; i++) printf(" %17s", "per frame");
+    printf("\n");
+
+    uint64_t seen = header->written.load(std::memory_order_acquire);
+    int idleSeconds = 0;
+    while (idleSeconds < 5) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        uint64_t written = header->written.load(std::memory_order_acquire);
+        if (written == seen) {
+            idleSeconds++;
+            continue;
+        }
+        idleSeconds = 0;
+        // The game restarted and the count with it
+        if (written < seen) seen = 0;
+
+        // Older frames than the ring holds are gone, take what is left
+        uint64_t first = written - seen > capacity ? written - capacity : seen;
+        std::vector<MetricsRow> copy;
+        for (uint64_t n = first; n < written; n++) copy.push_back(rows[n % capacity]);
+        uint64_t after = header->written.load(std::memory_order_acquire);
+        seen = written;
+
+        // Drop rows the game overwrote while they were copied
+        size_t torn = after - first > capacity ? (size_t)(after - first - capacity) : 0;
+        if (torn >= copy.size()) continue;
+        copy.erase(copy.begin(), copy.begin() + torn);
+
+        double total = 0, longest = 0;
+        double sums[METRIC_COUNT] = {};
+        for (const MetricsRow& row : copy) {
+            total += row.frameMilliseconds;
+            if (row.frameMilliseconds > longest) longest = row.frameMilliseconds;
+            for (int i = 0; i < METRIC_COUNT; i++) sums[i] += (double)row.values[i];
+        }
+        double frames = (double)copy.size();
+        printf("%8.1f %9.2f %9.2f", total > 0 ? frames * 1000.0 / total : 0.0, total / frames, longest);
+        for (int i = 0; i < METRIC_COUNT; i++) printf(" %17.1f", sums[i] / frames);
+        printf("\n");
+        fflush(stdout);
+    }
+
+    printf("No new frames for 5 seconds, stopping\n");
+    UnmapShared((void*)header, handle, name, false);
+    return 0;
+}
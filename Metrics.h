@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+// Counts of what the engine did each frame. Any thread may add, increments are
+// relaxed atomics and hot loops add their total once per call rather than per item.
+enum Metric {
+    METRIC_FIXED_STEPS,
+    METRIC_ENTITIES_UPDATED,
+    METRIC_COLLISION_TESTS,
+    METRIC_CONTACTS,
+    METRIC_SPRITES_SUBMITTED,
+    METRIC_DRAW_CALLS,
+    METRIC_STATE_CHANGES,
+    METRIC_BYTES_UPLOADED,
+    // Only counted in builds with ENGINE_ALLOC_TRACKING
+    METRIC_ALLOCATIONS,
+    METRIC_BYTES_ALLOCATED,
+    METRIC_COUNT
+};
+
+#define METRICS_SHM_VERSION 2
+#define METRICS_SHM_CAPACITY 1024
+#define METRICS_NAME_LENGTH 32
+
+// One frame, as written to the CSV and the shared memory ring
+struct MetricsRow {
+    uint64_t frame;
+    double time;  // seconds since start
+    double frameMilliseconds;
+    uint64_t values[METRIC_COUNT];
+};
+
+// Start of the shared memory block, followed by METRICS_SHM_CAPACITY rows. Frame n is
+// in row n % capacity and is complete once written > n. A reader copies the row, then
+// checks written is still below n + capacity, otherwise the copy may be torn.
+struct MetricsShmHeader {
+    char magic[4];  // "EMET"
+    uint32_t version;
+    uint32_t metricCount;
+    uint32_t capacity;
+    uint32_t rowSize;
+    uint32_t reserved;
+    std::atomic<uint64_t> written;
+    char names[METRIC_COUNT][METRICS_NAME_LENGTH];
+};
+
+class Metrics {
+public:
+
+    Metrics();
+    ~Metrics() { Close(); }
+
+    void Add(Metric metric, uint64_t amount)
+    {
+        counters[metric].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    // The current file is moved to path.1 every rowsPerFile frames
+    bool OpenCsv(const char* path, int rowsPerFile);
+    bool OpenSharedMemory(const char* name);
+    void Close();
+
+    // Main thread, once per frame. Takes the counts since the last call and exports them.
+    void EndFrame();
+    // The row the last EndFrame exported
+    const MetricsRow& LastRow() const { return last; }
+
+    static const char* Name(Metric metric);
+
+private:
+
+    std::atomic<uint64_t> counters[METRIC_COUNT];
+    uint64_t frame = 0;
+    double startTime = 0;
+    double lastFrame = 0;
+    MetricsRow last = {};
+
+    FILE* csv = NULL;
+    std::string csvPath;
+    int rowsPerFile = 0;
+    int rowsInFile = 0;
+
+    MetricsShmHeader* shm = NULL;
+    MetricsRow* shmRows = NULL;
+    std::string shmName;
+#ifdef _WIN32
+    void* shmHandle = NULL;
+#endif
+
+    bool StartCsvFile();
+    void WriteCsv(const MetricsRow& row);
+};
+
+extern Metrics metrics;
+
+// --metrics-watch name, prints what a running game publishes with --metrics-shm name
+int WatchMetrics(int argc, char* argv[]);
@@ -0,0 +1,133 @@
+#include "ParticleSystem.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLES_SSE2 1
+#include <emmintrin.h>
+#endif
+
+ParticleSystem::ParticleSystem()
+{
+    Reserve(1024);
+}
+
+void ParticleSystem::Reserve(int size)
+{
+    // Rounded up so the SIMD loop can always read whole groups of four
+    size = (size + 3) & ~3;
+    if ((int)x.size() >= size) return;
+
+    x.resize(size);
+    y.resize(size);
+    velocityX.resize(size);
+    velocityY.resize(size);
+    gravity.resize(size);
+    life.resize(size);
+    decay.resize(size);
+    color.resize(size);
+}
+
+float ParticleSystem::Random()
+{
+    // xorshift32, plenty for effects and much cheaper than rand()
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (float)(seed >> 8) * (1.0f / 16777216.0f);
+}
+
+void ParticleSystem::Burst(const ParticleEmitter& emitter, glm::vec3 position)
+{
+    int spawn = emitter.count;
+    if (count + spawn > maxParticles) spawn = maxParticles - count;
+    if (spawn <= 0) return;
+
+    if (count + spawn > (int)x.size()) {
+        int size = (int)x.size() * 2;
+        while (size < count + spawn) size *= 2;
+        Reserve(size < maxParticles ? size : maxParticles);
+    }
+
+    for (int i = count; i < count + spawn; i++) {
+        float angle = (Random() * 2.0f - 1.0f) * emitter.spread;
+        float speed = emitter.speed * (1.0f + (Random() * 2.0f - 1.0f) * emitter.speedVariance);
+        float lifetime = emitter.lifetime * (0.75f + Random() * 0.5f);
+
+        x[i] = position.x;
+        y[i] = position.y;
+        velocityX[i] = sinf(angle) * speed;
+        velocityY[i] = cosf(angle) * speed;
+        gravity[i] = emitter.gravity;
+        life[i] = 1.0f;
+        decay[i] = 1.0f / lifetime;
+        color[i] = emitter.color;
+    }
+    count += spawn;
+}
+
+void ParticleSystem::Update(float deltaTime)
+{
+    if (count == 0) return;
+    TRACE_SCOPE("ParticleSystem::Update");
+    TRACE_COUNTER("particles", count);
+
+    int i = 0;
+
+#if PARTICLES_SSE2
+    // Arrays are padded to a multiple of four, stepping the stale tail is harmless
+    __m128 dt = _mm_set1_ps(deltaTime);
+    for (; i < count; i += 4) {
+        __m128 vy = _mm_loadu_ps(&velocityY[i]);
+        __m128 vx = _mm_loadu_ps(&velocityX[i]);
+
+        vy = _mm_add_ps(vy, _mm_mul_ps(_mm_loadu_ps(&gravity[i]), dt));
+        _mm_storeu_ps(&velocityY[i], vy);
+
+        _mm_storeu_ps(&x[i], _mm_add_ps(_mm_loadu_ps(&x[i]), _mm_mul_ps(vx, dt)));
+        _mm_storeu_ps(&y[i], _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_mul_ps(vy, dt)));
+        _mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), _mm_mul_ps(_mm_loadu_ps(&decay[i]), dt)));
+    }
+#else
+    for (; i < count; i++) {
+        velocityY[i] += gravity[i] * deltaTime;
+        x[i] += velocityX[i] * deltaTime;
+        y[i] += velocityY[i] * deltaTime;
+        life[i] -= decay[i] * deltaTime;
+    }
+#endif
+
+    // Remove dead particles by moving the last live one into their slot
+    for (i = 0; i < count;) {
+        if (life[i] > 0.0f) {
+            i++;
+            continue;
+        }
+        int last = --count;
+        x[i] = x[last];
+        y[i] = y[last];
+        velocityX[i] = velocityX[last];
+        velocityY[i] = velocityY[last];
+        gravity[i] = gravity[last];
+        life[i] = life[last];
+        decay[i] = decay[last];
+        color[i] = color[last];
+    }
+}
+
+void ParticleSystem::Clear()
+{
+    count = 0;
+}
+
+void ParticleSystem::Render(RenderPacket* packet) const
+{
+    ParticleBatch& batch = packet->particles;
+    batch.size = particleSize;
+    batch.x.assign(x.begin(), x.begin() + count);
+    batch.y.assign(y.begin(), y.begin() + count);
+    batch.life.assign(life.begin(), life.begin() + count);
+    batch.color.assign(color.begin(), color.begin() + count);
+}
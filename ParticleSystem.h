@@ -0,0 +1,59 @@
+#pragma once
+
+#include "glm/vec3.hpp"
+#include "RenderPacket.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Packed 0xAABBGGRR so the bytes land as r, g, b, a in memory
+#define PARTICLE_COLOR(r, g, b, a) ((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24))
+
+// One kind of burst, e.g. the dust when an enemy is stomped
+struct ParticleEmitter {
+    int count;
+    uint32_t color;
+    float speed;
+    // Random fraction of speed added or removed per particle
+    float speedVariance;
+    // Launch direction is up, spread is the half angle in radians
+    float spread;
+    float lifetime;
+    float gravity;
+};
+
+// Short lived points stored as separate arrays per field so Update can step four
+// particles per instruction. Order is not kept, dead particles are replaced by the last one.
+class ParticleSystem {
+public:
+
+    int maxParticles = PARTICLE_BATCH_MAX;
+    // World units
+    float particleSize = 0.08f;
+
+    ParticleSystem();
+
+    void Burst(const ParticleEmitter& emitter, glm::vec3 position);
+    void Update(float deltaTime);
+    void Clear();
+    int Count() const { return count; }
+
+    // Copies the live particles into the packet for the render thread
+    void Render(RenderPacket* packet) const;
+
+private:
+
+    int count = 0;
+    uint32_t seed = 0x9E3779B9;
+
+    std::vector<float> x, y;
+    std::vector<float> velocityX, velocityY;
+    std::vector<float> gravity;
+    // Counts down from 1 to 0, the renderer fades alpha with it
+    std::vector<float> life;
+    std::vector<float> decay;
+    std::vector<uint32_t> color;
+
+    void Reserve(int size);
+    float Random();
+};
@@ -0,0 +1,357 @@
+#include "PerfGate.h"
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#define PERF_BASELINE_VERSION 1
+
+// Written to the baseline file, so no spaces
+static const char* replayPhaseNames[REPLAY_PHASE_COUNT] = { "streaming", "simulation", "rules", "submit" };
+
+struct GateSettings {
+    std::vector<const char*> sessions;
+    const char* baselinePath = "perf_baseline.txt";
+    bool update = false;
+    bool allocAssert = false;
+    int runs = 5;
+    double alpha = 0.01;
+    double threshold = 0.05;
+    // Medians closer than this are never a regression, however significant
+    double minimumMilliseconds = 0.0001;
+};
+
+struct SessionBaseline {
+    std::string name;
+    uint32_t steps = 0;
+    std::vector<uint64_t> checksums;
+    // Mean ms per frame of every block of every run
+    std::vector<double> blocks[REPLAY_PHASE_COUNT];
+};
+
+// Sessions are matched by file name so the baseline works from any checkout
+static std::string SessionName(const char* path)
+{
+    const char* name = path;
+    for (const char* c = path; *c != 0; c++) {
+        if (*c == '/' || *c == '\\') name = c + 1;
+    }
+    return name;
+}
+
+static bool ReadBaselines(const char* path, std::vector<SessionBaseline>* baselines)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return false;
+
+    char token[256];
+    int version = 0;
+    bool valid = fscanf(file, "%255s %d", token, &version) == 2 && strcmp(token, "perf-gate") == 0 &&
+        version == PERF_BASELINE_VERSION;
+
+    SessionBaseline* session = NULL;
+    while (valid && fscanf(file, "%255s", token) == 1) {
+        unsigned count = 0;
+        if (strcmp(token, "session") == 0) {
+            baselines->push_back(SessionBaseline());
+            session = &baselines->back();
+            valid = fscanf(file, "%255s %" SCNu32, token, &session->steps) == 2;
+            session->name = token;
+            continue;
+        }
+        if (session == NULL || fscanf(file, "%u", &count) != 1) {
+            valid = false;
+            break;
+        }
+
+        if (strcmp(token, "checksums") == 0) {
+            session->checksums.resize(count);
+            for (unsigned i = 0; i < count && valid; i++) valid = fscanf(file, "%" SCNx64, &session->checksums[i]) == 1;
+            continue;
+        }
+
+        int phase = 0;
+        while (phase < REPLAY_PHASE_COUNT && strcmp(token, replayPhaseNames[phase]) != 0) phase++;
+        if (phase == REPLAY_PHASE_COUNT) {
+            valid = false;
+            break;
+        }
+        session->blocks[phase].resize(count);
+        for (unsigned i = 0; i < count && valid; i++) valid = fscanf(file, "%lf", &session->blocks[phase][i]) == 1;
+    }
+
+    fclose(file);
+    if (valid == false) printf("%s is not a valid baseline file\n", path);
+    return valid;
+}
+
+static bool WriteBaselines(const char* path, const std::vector<SessionBaseline>& baselines)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+
+    fprintf(file, "perf-gate %d\n", PERF_BASELINE_VERSION);
+    for (const SessionBaseline& session : baselines) {
+        fprintf(file, "session %s %" PRIu32 "\n", session.name.c_str(), session.steps);
+        fprintf(file, "checksums %zu", session.checksums.size());
+        for (uint64_t checksum : session.checksums) fprintf(file, " %016" PRIx64, checksum);
+        fprintf(file, "\n");
+        for (int phase = 0; phase < REPLAY_PHASE_COUNT; phase++) {
+            fprintf(file, "%s %zu", replayPhaseNames[phase], session.blocks[phase].size());
+            for (double value : session.blocks[phase]) fprintf(file, " %.6g", value);
+            fprintf(file, "\n");
+        }
+    }
+
+    bool written = ferror(file) == 0;
+    fclose(file);
+    return written;
+}
+
+static double Median(std::vector<double> values)
+{
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t count = values.size();
+    return count % 2 == 1 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+// p-value of a one sided Mann-Whitney U test that values in b tend to be larger than
+// those in a. Uses the normal approximation with tie and continuity corrections,
+// which is fine at the dozens of blocks a session gives.
+static double MannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double n1 = (double)a.size();
+    double n2 = (double)b.size();
+    if (a.empty() || b.empty()) return 1.0;
+
+    std::vector<std::pair<double, int>> all;
+    all.reserve(a.size() + b.size());
+    for (double value : a) all.push_back(std::make_pair(value, 0));
+    for (double value : b) all.push_back(std::make_pair(value, 1));
+    std::sort(all.begin(), all.end());
+
+    // Tied values share the mean of the ranks they span
+    double rankSumB = 0;
+    double ties = 0;
+    for (size_t i = 0; i < all.size();) {
+        size_t end = i;
+        while (end < all.size() && all[end].first == all[i].first) end++;
+        double rank = (double)(i + 1 + end) / 2.0;
+        double t = (double)(end - i);
+        ties += t * t * t - t;
+        for (size_t j = i; j < end; j++) {
+            if (all[j].second == 1) rankSumB += rank;
+        }
+        i = end;
+    }
+
+    double n = n1 + n2;
+    double u = rankSumB - n2 * (n2 + 1) / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)));
+    if (variance <= 0) return 1.0;
+
+    double z = (u - n1 * n2 / 2.0 - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+// Mean ms per frame over each block
+static void AddBlocks(const std::vector<double>& frames, std::vector<double>* blocks)
+{
+    for (size_t start = 0; start < frames.size(); start += REPLAY_BLOCK_FRAMES) {
+        size_t end = std::min(frames.size(), start + REPLAY_BLOCK_FRAMES);
+        double sum = 0;
+        for (size_t i = start; i < end; i++) sum += frames[i];
+        blocks->push_back(sum / (double)(end - start));
+    }
+}
+
+// End of the first block where two checksum lists disagree, -1 if they never do
+static long long FirstMismatch(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b)
+{
+    size_t count = std::min(a.size(), b.size());
+    for (size_t i = 0; i < count; i++) {
+        if (a[i] != b[i]) return (long long)(i + 1) * REPLAY_BLOCK_FRAMES;
+    }
+    if (a.size() != b.size()) return (long long)count * REPLAY_BLOCK_FRAMES;
+    return -1;
+}
+
+// Replays the session settings.runs times after a warm up run, false on error
+static bool MeasureSession(const char* path, const GateSettings& settings, ReplayFunction replay, SessionBaseline* measured)
+{
+    InputRecording recording;
+    if (recording.Read(path) == false) {
+        printf("Unable to read session %s\n", path);
+        return false;
+    }
+    measured->name = SessionName(path);
+    measured->steps = (uint32_t)recording.steps.size();
+
+    // The warm up run is only used for its checksums
+    ReplayResult reference;
+    if (replay(recording, &reference) == false) {
+        printf("Unable to load level %s for %s\n", recording.level.c_str(), path);
+        return false;
+    }
+    measured->checksums = reference.checksums;
+
+    for (int run = 0; run < settings.runs; run++) {
+        ReplayResult result;
+        replay(recording, &result);
+        long long mismatch = FirstMismatch(reference.checksums, result.checksums);
+        if (mismatch >= 0) {
+            printf("%s: runs of the same build diverge by frame %lld, the simulation is not deterministic\n",
+                measured->name.c_str(), mismatch);
+            return false;
+        }
+        for (int phase = 0; phase < REPLAY_PHASE_COUNT; phase++) AddBlocks(result.phases[phase], &measured->blocks[phase]);
+    }
+    return true;
+}
+
+static bool CompareSession(const SessionBaseline& baseline, const SessionBaseline& current, const GateSettings& settings)
+{
+    printf("%s: %u steps, %zu blocks per phase\n", current.name.c_str(), current.steps, current.blocks[0].size());
+
+    bool passed = true;
+    long long mismatch = FirstMismatch(baseline.checksums, current.checksums);
+    if (baseline.steps != current.steps) {
+        printf("  session has %u steps, the baseline was recorded with %u\n", current.steps, baseline.steps);
+        passed = false;
+    }
+    else if (mismatch >= 0) {
+        printf("  DESYNC, the simulation differs from the baseline by frame %lld\n", mismatch);
+        passed = false;
+    }
+
+    printf("  %-12s %12s %12s %9s %10s\n", "phase", "baseline us", "current us", "change", "p");
+    for (int phase = 0; phase < REPLAY_PHASE_COUNT; phase++) {
+        double before = Median(baseline.blocks[phase]);
+        double after = Median(current.blocks[phase]);
+        double change = before > 0 ? after / before - 1.0 : 0.0;
+        double p = MannWhitneyGreater(baseline.blocks[phase], current.blocks[phase]);
+
+        bool slower = p < settings.alpha && change > settings.threshold && after - before > settings.minimumMilliseconds;
+        if (slower) passed = false;
+        printf("  %-12s %12.3f %12.3f %+8.1f%% %10.2g%s\n", replayPhaseNames[phase], before * 1000.0, after * 1000.0, change * 100.0, p,
+            slower ? "  SLOWER" : "");
+    }
+    return passed;
+}
+
+static bool ParseSettings(int argc, char* argv[], GateSettings* settings)
+{
+    for (int i = 0; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--baseline") == 0 && hasValue) settings->baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--update-baseline") == 0) settings->update = true;
+        else if (strcmp(argv[i], "--alloc-assert") == 0) settings->allocAssert = true;
+        else if (strcmp(argv[i], "--runs") == 0 && hasValue) settings->runs = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--alpha") == 0 && hasValue) settings->alpha = atof(argv[++i]);
+        else if (strcmp(argv[i], "--threshold") == 0 && hasValue) settings->threshold = atof(argv[++i]) / 100.0;
+        else if (argv[i][0] != '-') settings->sessions.push_back(argv[i]);
+        else return false;
+    }
+    return settings->sessions.empty() == false;
+}
+
+// Replays each session once to warm up and again with the tracker armed, a session
+// fails when a frame of the second run allocates
+static int CheckAllocations(const GateSettings& settings, ReplayFunction replay)
+{
+#ifdef ENGINE_ALLOC_TRACKING
+    allocationTracker.assertInFrame = true;
+    int failed = 0;
+    for (const char* path : settings.sessions) {
+        InputRecording recording;
+        ReplayResult warmup;
+        if (recording.Read(path) == false || replay(recording, &warmup) == false) {
+            printf("Unable to replay session %s\n", path);
+            failed++;
+            continue;
+        }
+
+        uint64_t before = allocationTracker.inFrame.load();
+        allocationTracker.armed = true;
+        ReplayResult checked;
+        replay(recording, &checked);
+        allocationTracker.armed = false;
+
+        uint64_t allocations = allocationTracker.inFrame.load() - before;
+        printf("%s: %llu allocations in %zu frames%s\n", SessionName(path).c_str(), (unsigned long long)allocations,
+            checked.phases[REPLAY_SIMULATION].size(), allocations > 0 ? "  ALLOCATES" : "");
+        if (allocations > 0) failed++;
+    }
+
+    printf("%s, %d of %zu sessions failed\n", failed > 0 ? "FAIL" : "PASS", failed, settings.sessions.size());
+    return failed > 0 ? 1 : 0;
+#else
+    (void)settings;
+    (void)replay;
+    printf("--alloc-assert needs a build with ENGINE_ALLOC_TRACKING defined\n");
+    return 1;
+#endif
+}
+
+int RunPerfGate(int argc, char* argv[], ReplayFunction replay)
+{
+    GateSettings settings;
+    if (ParseSettings(argc, argv, &settings) == false) {
+        printf("usage: --perf-gate session.inp [more.inp ...] [--baseline file] [--update-baseline]\n"
+               "                   [--runs n] [--alpha a] [--threshold percent] [--alloc-assert]\n");
+        return 1;
+    }
+    // Timings of a tracking build aren't comparable with the baseline, nothing else is checked
+    if (settings.allocAssert) return CheckAllocations(settings, replay);
+
+    // Sessions not given are kept when updating
+    std::vector<SessionBaseline> baselines;
+    bool haveBaselines = ReadBaselines(settings.baselinePath, &baselines);
+    if (haveBaselines == false && settings.update == false) {
+        printf("No baseline in %s, record one with --update-baseline\n", settings.baselinePath);
+        return 1;
+    }
+
+    int failed = 0;
+    for (const char* path : settings.sessions) {
+        SessionBaseline current;
+        if (MeasureSession(path, settings, replay, &current) == false) {
+            failed++;
+            continue;
+        }
+
+        auto existing = std::find_if(baselines.begin(), baselines.end(),
+            [&](const SessionBaseline& baseline) { return baseline.name == current.name; });
+
+        if (settings.update) {
+            printf("%s: %u steps, recorded\n", current.name.c_str(), current.steps);
+            if (existing != baselines.end()) *existing = current;
+            else baselines.push_back(current);
+        }
+        else if (existing == baselines.end()) {
+            printf("%s: not in %s, record it with --update-baseline\n", current.name.c_str(), settings.baselinePath);
+            failed++;
+        }
+        else if (CompareSession(*existing, current, settings) == false) {
+            failed++;
+        }
+    }
+
+    if (settings.update) {
+        if (WriteBaselines(settings.baselinePath, baselines) == false) {
+            printf("Unable to write %s\n", settings.baselinePath);
+            return 1;
+        }
+        return failed > 0 ? 1 : 0;
+    }
+
+    printf("%s, %d of %zu sessions failed\n", failed > 0 ? "FAIL" : "PASS", failed, settings.sessions.size());
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "InputRecording.h"
+
+#include <stdint.h>
+#include <vector>
+
+// --perf-gate session.inp [more.inp ...] [--baseline file] [--update-baseline]
+//             [--runs n] [--alpha a] [--threshold percent] [--alloc-assert]
+// Replays sessions recorded with --record-input headless, frame by frame as recorded, and
+// compares each against the baseline file. A session fails when its simulation
+// checksums differ from the baseline (a desync) or when a phase is slower with
+// significance alpha by a one sided Mann-Whitney U test and by more than threshold
+// percent at the median. --update-baseline records the current build instead.
+// --alloc-assert, in a build with ENGINE_ALLOC_TRACKING, replays each session after a
+// warm up run and fails any session whose frames allocate, in place of the comparison.
+// Returns 0 when every session passes.
+
+enum ReplayPhase { REPLAY_STREAMING, REPLAY_SIMULATION, REPLAY_RULES, REPLAY_SUBMIT, REPLAY_PHASE_COUNT };
+
+// Timings are averaged, and the simulation checksummed, over blocks of this many frames
+#define REPLAY_BLOCK_FRAMES 60
+
+struct ReplayResult {
+    std::vector<double> phases[REPLAY_PHASE_COUNT];  // ms per frame
+    // After every block, the last one may be short
+    std::vector<uint64_t> checksums;
+};
+
+// Plays a session from a freshly built world, false if its level could not be loaded
+typedef bool (*ReplayFunction)(const InputRecording& recording, ReplayResult* result);
+
+int RunPerfGate(int argc, char* argv[], ReplayFunction replay);
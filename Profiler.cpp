@@ -0,0 +1,453 @@
+#include "Profiler.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <link.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+Profiler profiler;
+
+thread_local volatile int profilePhase = PROFILE_OTHER;
+
+static const char* phaseNames[PROFILE_PHASE_COUNT] = {
+    "other", "input", "update", "fixed step", "collision", "ai", "rules", "render submit"
+};
+
+// Stacks that can't find a free slot within this many probes are dropped
+#define PROFILE_MAX_PROBES 64
+
+const char* Profiler::Name(ProfilePhase phase)
+{
+    return phaseNames[phase];
+}
+
+#ifdef __linux__
+
+static thread_local ProfileThread* currentThread = NULL;
+
+// backtrace isn't safe in a signal handler, the unwinder takes the loader's lock, so
+// the handler follows the frame pointer chain of the code it interrupted instead. Every
+// record is checked to lie on the thread's stack above the interrupted stack pointer,
+// so code built without frame pointers only ends the stack early.
+static void ProfileSignal(int, siginfo_t*, void* context)
+{
+    ProfileThread* thread = currentThread;
+    if (thread == NULL) return;
+
+    const mcontext_t& registers = ((ucontext_t*)context)->uc_mcontext;
+#if defined(__x86_64__)
+    uintptr_t pc = (uintptr_t)registers.gregs[REG_RIP];
+    uintptr_t sp = (uintptr_t)registers.gregs[REG_RSP];
+    uintptr_t fp = (uintptr_t)registers.gregs[REG_RBP];
+#elif defined(__aarch64__)
+    uintptr_t pc = (uintptr_t)registers.pc;
+    uintptr_t sp = (uintptr_t)registers.sp;
+    uintptr_t fp = (uintptr_t)registers.regs[29];
+#else
+    return;
+#endif
+
+    // Each record is the caller's frame pointer followed by the return address
+    void* frames[PROFILE_MAX_DEPTH];
+    int depth = 0;
+    frames[depth++] = (void*)pc;
+    while (depth < PROFILE_MAX_DEPTH && fp >= sp && fp % sizeof(uintptr_t) == 0 &&
+        fp + 2 * sizeof(uintptr_t) <= thread->stackTop) {
+        const uintptr_t* record = (const uintptr_t*)fp;
+        if (record[1] == 0) break;
+        frames[depth++] = (void*)record[1];
+        if (record[0] <= fp) break;
+        fp = record[0];
+    }
+
+    int savedErrno = errno;
+    profiler.Sample(frames, depth);
+    errno = savedErrno;
+}
+
+static void StopTimer(ProfileThread* thread)
+{
+    if (thread->hasTimer.exchange(false)) timer_delete((timer_t)thread->timer);
+}
+
+// Deletes the timer when a registered thread exits, the samples stay with the profiler
+struct ProfileThreadExit {
+    ~ProfileThreadExit()
+    {
+        if (currentThread != NULL) StopTimer(currentThread);
+        currentThread = NULL;
+    }
+};
+
+static thread_local ProfileThreadExit threadExit;
+
+void Profiler::Start()
+{
+    if (enabled == false) return;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = ProfileSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, NULL) != 0) {
+        printf("Profiler unavailable: %s\n", strerror(errno));
+        return;
+    }
+    running = true;
+}
+
+void Profiler::RegisterThread(const char* name)
+{
+    if (running == false || currentThread != NULL) return;
+
+    std::unique_ptr<ProfileThread> thread(new ProfileThread());
+    thread->name = name;
+    thread->stacks.reset(new ProfileStack[PROFILE_STACKS_PER_THREAD]());
+    thread->frames.reset(new uintptr_t[PROFILE_FRAMES_PER_THREAD]);
+
+    // Where the handler's stack walk has to stop
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) == 0) {
+        void* stack;
+        size_t stackSize;
+        if (pthread_attr_getstack(&attributes, &stack, &stackSize) == 0) thread->stackTop = (uintptr_t)stack + stackSize;
+        pthread_attr_destroy(&attributes);
+    }
+
+    // Counts CPU time of this thread only, so a thread waiting on a lock or vsync gets
+    // no samples and the others aren't starved of them
+    sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+    timer_t timer;
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer) != 0) {
+        printf("Profiler unable to sample %s: %s\n", name, strerror(errno));
+        return;
+    }
+    thread->timer = (void*)timer;
+    thread->hasTimer = true;
+
+    currentThread = thread.get();
+    (void)&threadExit;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threads.push_back(std::move(thread));
+    }
+
+    long interval = 1000000000L / std::max(1, frequency);
+    itimerspec spec;
+    spec.it_interval.tv_sec = interval / 1000000000L;
+    spec.it_interval.tv_nsec = interval % 1000000000L;
+    spec.it_value = spec.it_interval;
+    timer_settime(timer, 0, &spec, NULL);
+}
+
+void Profiler::Sample(void** frames, int depth)
+{
+    ProfileThread* thread = currentThread;
+    if (thread == NULL) return;
+
+    // Stop waits for this to clear before reading the table
+    thread->sampling = true;
+    if (running == false) {
+        thread->sampling = false;
+        return;
+    }
+
+    uint8_t phase = (uint8_t)profilePhase;
+    uint64_t hash = HashBytes(frames, depth * sizeof(void*), phase);
+    thread->samples++;
+    thread->phaseSamples[phase]++;
+
+    for (int probe = 0; probe < PROFILE_MAX_PROBES; probe++) {
+        ProfileStack& stack = thread->stacks[(hash + probe) & (PROFILE_STACKS_PER_THREAD - 1)];
+        if (stack.count == 0) {
+            if (thread->framesUsed + depth > PROFILE_FRAMES_PER_THREAD) break;
+            stack.hash = hash;
+            stack.offset = thread->framesUsed;
+            stack.depth = (uint16_t)depth;
+            stack.phase = phase;
+            stack.count = 1;
+            for (int i = 0; i < depth; i++) thread->frames[stack.offset + i] = (uintptr_t)frames[i];
+            thread->framesUsed += depth;
+            thread->sampling = false;
+            return;
+        }
+        if (stack.hash == hash && stack.phase == phase && stack.depth == depth &&
+            memcmp(&thread->frames[stack.offset], frames, depth * sizeof(void*)) == 0) {
+            stack.count++;
+            thread->sampling = false;
+            return;
+        }
+    }
+
+    thread->dropped++;
+    thread->sampling = false;
+}
+
+void Profiler::Stop()
+{
+    if (running.exchange(false) == false) return;
+
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (auto& thread : threads) {
+            StopTimer(thread.get());
+            while (thread->sampling) std::this_thread::yield();
+        }
+    }
+    Write();
+}
+
+// Function symbols of one loaded module, from .symtab when the file has one so
+// static functions resolve without linking with -rdynamic
+struct ModuleSymbols {
+    struct Symbol {
+        uintptr_t start;
+        uintptr_t end;
+        const char* name;
+    };
+
+    MappedFile file;
+    uintptr_t bias = 0;
+    std::vector<Symbol> symbols;
+
+    void Load(const char* path, uintptr_t base)
+    {
+        if (file.Open(path) == false || file.size < sizeof(ElfW(Ehdr))) return;
+
+        const ElfW(Ehdr)* header = (const ElfW(Ehdr)*)file.data;
+        if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 || header->e_shentsize != sizeof(ElfW(Shdr)) ||
+            header->e_shoff + (size_t)header->e_shnum * sizeof(ElfW(Shdr)) > file.size ||
+            header->e_phoff + (size_t)header->e_phnum * sizeof(ElfW(Phdr)) > file.size) return;
+
+        // The lowest segment is where the module was mapped, zero for executables that aren't PIE
+        const ElfW(Phdr)* segments = (const ElfW(Phdr)*)(file.data + header->e_phoff);
+        uintptr_t lowest = UINTPTR_MAX;
+        for (int i = 0; i < header->e_phnum; i++) {
+            if (segments[i].p_type == PT_LOAD) lowest = std::min(lowest, (uintptr_t)(segments[i].p_vaddr & ~(uintptr_t)0xfff));
+        }
+        if (lowest == UINTPTR_MAX) return;
+        bias = base - lowest;
+
+        const ElfW(Shdr)* sections = (const ElfW(Shdr)*)(file.data + header->e_shoff);
+        const ElfW(Shdr)* table = NULL;
+        for (int i = 0; i < header->e_shnum; i++) {
+            if (sections[i].sh_type == SHT_SYMTAB) table = &sections[i];
+        }
+        for (int i = 0; i < header->e_shnum && table == NULL; i++) {
+            if (sections[i].sh_type == SHT_DYNSYM) table = &sections[i];
+        }
+        if (table == NULL || table->sh_link >= header->e_shnum || table->sh_offset + table->sh_size > file.size) return;
+        const ElfW(Shdr)& strings = sections[table->sh_link];
+        if (strings.sh_offset + strings.sh_size > file.size) return;
+
+        const ElfW(Sym)* entries = (const ElfW(Sym)*)(file.data + table->sh_offset);
+        size_t count = table->sh_size / sizeof(ElfW(Sym));
+        const char* names = (const char*)(file.data + strings.sh_offset);
+        for (size_t i = 0; i < count; i++) {
+            const ElfW(Sym)& entry = entries[i];
+            if (ELF64_ST_TYPE(entry.st_info) != STT_FUNC || entry.st_shndx == SHN_UNDEF || entry.st_value == 0) continue;
+            if (entry.st_name >= strings.sh_size) continue;
+            uintptr_t start = (uintptr_t)entry.st_value;
+            symbols.push_back({ start, start + std::max<uintptr_t>(entry.st_size, 1), names + entry.st_name });
+        }
+        std::sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) { return a.start < b.start; });
+    }
+
+    const char* Find(uintptr_t address) const
+    {
+        address -= bias;
+        auto next = std::upper_bound(symbols.begin(), symbols.end(), address,
+            [](uintptr_t value, const Symbol& symbol) { return value < symbol.start; });
+        if (next == symbols.begin()) return NULL;
+        --next;
+        return address < next->end ? next->name : NULL;
+    }
+};
+
+// Demangled, without the argument list, which only makes the graph harder to read
+static std::string FunctionName(const char* mangled)
+{
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled, NULL, NULL, &status);
+    std::string name = status == 0 && demangled != NULL ? demangled : mangled;
+    free(demangled);
+
+    if (name.size() > 6 && name.compare(name.size() - 6, 6, " const") == 0) name.resize(name.size() - 6);
+    if (name.empty() == false && name.back() == ')') {
+        int nesting = 0;
+        for (size_t i = name.size(); i-- > 0;) {
+            if (name[i] == ')') nesting++;
+            else if (name[i] == '(' && --nesting == 0) {
+                if (i > 0) name.resize(i);
+                break;
+            }
+        }
+    }
+    // Frames are separated by semicolons in the folded format
+    std::replace(name.begin(), name.end(), ';', ':');
+    return name;
+}
+
+class Symbolizer {
+public:
+
+    Symbolizer()
+    {
+        Dl_info info;
+        if (dladdr((void*)&ProfileSignal, &info) != 0) executableBase = (uintptr_t)info.dli_fbase;
+    }
+
+    // Return addresses point past the call, they are looked up one byte back
+    const std::string& Resolve(uintptr_t address, bool leaf)
+    {
+        uintptr_t lookup = leaf ? address : address - 1;
+        auto found = names.find(lookup);
+        if (found != names.end()) return found->second;
+
+        std::string name;
+        Dl_info info;
+        if (dladdr((void*)lookup, &info) == 0 || info.dli_fname == NULL) {
+            char text[32];
+            snprintf(text, sizeof(text), "0x%llx", (unsigned long long)address);
+            name = text;
+        }
+        else {
+            const char* symbol = Module(info)->Find(lookup);
+            if (symbol == NULL) symbol = info.dli_sname;
+            if (symbol != NULL) {
+                name = FunctionName(symbol);
+            }
+            else {
+                // Module and offset, which addr2line can still resolve
+                const char* file = strrchr(info.dli_fname, '/');
+                char text[256];
+                snprintf(text, sizeof(text), "%s+0x%llx", file != NULL ? file + 1 : info.dli_fname,
+                    (unsigned long long)(lookup - (uintptr_t)info.dli_fbase));
+                name = text;
+            }
+        }
+        return names.emplace(lookup, name).first->second;
+    }
+
+private:
+
+    uintptr_t executableBase = 0;
+    std::map<uintptr_t, std::unique_ptr<ModuleSymbols>> modules;
+    std::unordered_map<uintptr_t, std::string> names;
+
+    ModuleSymbols* Module(const Dl_info& info)
+    {
+        uintptr_t base = (uintptr_t)info.dli_fbase;
+        std::unique_ptr<ModuleSymbols>& module = modules[base];
+        if (!module) {
+            module.reset(new ModuleSymbols());
+            // The executable's name is whatever it was started as, the kernel knows the file
+            module->Load(base == executableBase ? "/proc/self/exe" : info.dli_fname, base);
+        }
+        return module.get();
+    }
+};
+
+void Profiler::Write()
+{
+    Symbolizer symbolizer;
+
+    // Stacks that differ only in return addresses inside the same functions are merged
+    std::map<std::string, uint64_t> folded;
+    uint64_t samples = 0;
+    uint64_t dropped = 0;
+    for (auto& thread : threads) {
+        samples += thread->samples;
+        dropped += thread->dropped;
+        for (int i = 0; i < PROFILE_STACKS_PER_THREAD; i++) {
+            const ProfileStack& stack = thread->stacks[i];
+            if (stack.count == 0) continue;
+
+            std::string line = thread->name;
+            line += ';';
+            line += phaseNames[stack.phase];
+            for (int frame = stack.depth - 1; frame >= 0; frame--) {
+                line += ';';
+                line += symbolizer.Resolve(thread->frames[stack.offset + frame], frame == 0);
+            }
+            folded[line] += stack.count;
+        }
+    }
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        printf("Unable to write profile %s\n", path.c_str());
+        return;
+    }
+    for (auto& entry : folded) fprintf(file, "%s %llu\n", entry.first.c_str(), (unsigned long long)entry.second);
+    bool written = ferror(file) == 0;
+    fclose(file);
+    if (written == false) {
+        printf("Unable to write profile %s\n", path.c_str());
+        return;
+    }
+
+    printf("Profile: %llu samples, %llu dropped, %zu stacks written to %s\n", (unsigned long long)samples,
+        (unsigned long long)dropped, folded.size(), path.c_str());
+    for (auto& thread : threads) {
+        if (thread->samples == 0) continue;
+        printf("  %-16s %7llu", thread->name, (unsigned long long)thread->samples);
+        for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            if (thread->phaseSamples[i] == 0) continue;
+            printf(" | %s %.1f%%", phaseNames[i], thread->phaseSamples[i] * 100.0 / thread->samples);
+        }
+        printf("\n");
+    }
+}
+
+#else
+
+void Profiler::Start()
+{
+    if (enabled) printf("The sampling profiler is only on Linux\n");
+}
+
+void Profiler::RegisterThread(const char* name)
+{
+}
+
+void Profiler::Sample(void** frames, int depth)
+{
+}
+
+void Profiler::Stop()
+{
+}
+
+void Profiler::Write()
+{
+}
+
+#endif
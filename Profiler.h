@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// What the engine is doing, set by ProfilePhaseScope and recorded with every sample
+enum ProfilePhase {
+    PROFILE_OTHER,
+    PROFILE_INPUT,
+    PROFILE_UPDATE,
+    PROFILE_FIXED_STEP,
+    PROFILE_COLLISION,
+    PROFILE_AI,
+    PROFILE_RULES,
+    PROFILE_RENDER_SUBMIT,
+    PROFILE_PHASE_COUNT
+};
+
+#define PROFILE_MAX_DEPTH 64
+#define PROFILE_STACKS_PER_THREAD 16384
+#define PROFILE_FRAMES_PER_THREAD (1 << 18)
+
+// One distinct stack and phase, and how often it was sampled
+struct ProfileStack {
+    uint64_t hash;
+    uint32_t offset;  // into the thread's frames, leaf first
+    uint16_t depth;
+    uint8_t phase;
+    uint32_t count;
+};
+
+// Written only by the signal handler on its own thread. Everything is allocated when
+// the thread registers, the handler just hashes the stack into the table.
+struct ProfileThread {
+    const char* name = NULL;
+    std::unique_ptr<ProfileStack[]> stacks;
+    std::unique_ptr<uintptr_t[]> frames;
+    uint32_t framesUsed = 0;
+    uint64_t samples = 0;
+    uint64_t dropped = 0;
+    uint64_t phaseSamples[PROFILE_PHASE_COUNT] = {};
+    std::atomic<bool> sampling;
+    std::atomic<bool> hasTimer;
+    void* timer = NULL;
+    uintptr_t stackTop = 0;
+
+    ProfileThread() : sampling(false), hasTimer(false) {}
+};
+
+// Sampling profiler, Linux only. Every registered thread gets a timer on its own CPU
+// time that sends SIGPROF, and the handler walks the stack's frame pointers, so build
+// with -fno-omit-frame-pointer for whole stacks. Stacks are
+// symbolized when the profiler stops and written as folded stacks, one
+// "thread;phase;outermost;...;innermost count" per line, which flamegraph.pl,
+// speedscope and inferno read as they are.
+class Profiler {
+public:
+
+    bool enabled = false;
+    int frequency = 1000;
+    std::string path = "profile.folded";
+
+    // Before any engine thread starts
+    void Start();
+    // Once the other threads are joined, writes the file
+    void Stop();
+
+    // At the top of each engine thread, does nothing unless started
+    void RegisterThread(const char* name);
+
+    static const char* Name(ProfilePhase phase);
+
+    // Signal handler only, frames leaf first
+    void Sample(void** frames, int depth);
+
+private:
+
+    std::atomic<bool> running{ false };
+    std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ProfileThread>> threads;
+
+    void Write();
+};
+
+extern Profiler profiler;
+
+// The calling thread's phase, read by the signal handler
+extern thread_local volatile int profilePhase;
+
+// Marks the enclosing block as a phase. Costs two stores, so it stays in whether
+// the profiler runs or not.
+class ProfilePhaseScope {
+public:
+    ProfilePhaseScope(ProfilePhase phase) : previous(profilePhase)
+    {
+        profilePhase = phase;
+    }
+
+    ~ProfilePhaseScope()
+    {
+        profilePhase = previous;
+    }
+
+private:
+    int previous;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include "glm/mat4x4.hpp"
+
+#include "FrameArena.h"
+
+#include <stdint.h>
+
+// One textured unit quad. u/v/width/height select the region of the texture.
+struct SpriteInstance {
+    GLuint textureID;
+    glm::vec3 position;
+    float u, v, width, height;
+};
+
+struct TextInstance {
+    GLuint fontTextureID;
+    // Has to stay valid until the packet is drawn, copy anything that isn't a literal
+    // into the packet's arena
+    const char* text;
+    float size;
+    float spacing;
+    glm::vec3 position;
+};
+
+// The most particles a packet has room for without spilling, ParticleSystem::maxParticles
+// defaults to it
+#define PARTICLE_BATCH_MAX 100000
+#define PARTICLE_BATCH_BYTES (PARTICLE_BATCH_MAX * (3 * sizeof(float) + sizeof(uint32_t)))
+
+// Live particles as parallel arrays, drawn as one batch of points
+struct ParticleBatch {
+    float size = 0;
+    FrameVector<float> x;
+    FrameVector<float> y;
+    FrameVector<float> life;
+    FrameVector<uint32_t> color;
+
+    ParticleBatch(FrameArena* arena) : x(FrameAllocator<float>(arena)), y(FrameAllocator<float>(arena)),
+        life(FrameAllocator<float>(arena)), color(FrameAllocator<uint32_t>(arena)) {}
+
+    // Storage has to be let go of before the arena is reset
+    void Release()
+    {
+        FrameVector<float>(x.get_allocator()).swap(x);
+        FrameVector<float>(y.get_allocator()).swap(y);
+        FrameVector<float>(life.get_allocator()).swap(life);
+        FrameVector<uint32_t>(color.get_allocator()).swap(color);
+    }
+
+    void Reserve(size_t count)
+    {
+        x.reserve(count);
+        y.reserve(count);
+        life.reserve(count);
+        color.reserve(count);
+    }
+};
+
+// Sprites, text and a full particle budget, with some slack for alignment
+#define RENDER_PACKET_ARENA_SIZE (512 * 1024 + PARTICLE_BATCH_BYTES + 4096)
+
+// Everything the render thread needs to draw one frame. The simulation fills a
+// packet, hands it over and never touches it again until the renderer gives it back.
+// All of it lives in the packet's own arena, which is emptied when the packet is reused.
+struct RenderPacket {
+    FrameArena arena;
+
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+
+    // Screen space matrices for text
+    glm::mat4 hudViewMatrix;
+    glm::mat4 hudProjectionMatrix;
+
+    FrameVector<SpriteInstance> tiles;
+    FrameVector<SpriteInstance> sprites;
+    FrameVector<TextInstance> texts;
+    ParticleBatch particles;
+
+    RenderPacket() : arena(RENDER_PACKET_ARENA_SIZE), tiles(FrameAllocator<SpriteInstance>(&arena)),
+        sprites(FrameAllocator<SpriteInstance>(&arena)), texts(FrameAllocator<TextInstance>(&arena)), particles(&arena) {}
+
+    void Clear()
+    {
+        // Room for as much as last time, so nothing grows and leaves copies behind in the arena
+        size_t tileCount = tiles.size(), spriteCount = sprites.size();
+        size_t textCount = texts.size(), particleCount = particles.x.size();
+
+        FrameVector<SpriteInstance>(tiles.get_allocator()).swap(tiles);
+        FrameVector<SpriteInstance>(sprites.get_allocator()).swap(sprites);
+        FrameVector<TextInstance>(texts.get_allocator()).swap(texts);
+        particles.Release();
+        arena.Reset();
+
+        tiles.reserve(tileCount > 64 ? tileCount : 64);
+        sprites.reserve(spriteCount > 64 ? spriteCount : 64);
+        texts.reserve(textCount > 4 ? textCount : 4);
+        particles.Reserve(particleCount > 256 ? particleCount : 256);
+    }
+};
@@ -0,0 +1,93 @@
+#include "RenderTarget.h"
+
+#include <cstdio>
+
+void RenderTarget::Init()
+{
+    int major = 0, minor = 0;
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (version != NULL) sscanf(version, "%d.%d", &major, &minor);
+
+    supported = major >= 3 || SDL_GL_ExtensionSupported("GL_ARB_framebuffer_object");
+    if (supported == false) {
+        printf("Framebuffer objects not supported, dynamic resolution disabled\n");
+    }
+}
+
+void RenderTarget::Cleanup()
+{
+    if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+    if (colorTexture != 0) glDeleteTextures(1, &colorTexture);
+    framebuffer = 0;
+    colorTexture = 0;
+    width = 0;
+    height = 0;
+}
+
+bool RenderTarget::Allocate(int width, int height)
+{
+    Cleanup();
+
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Offscreen framebuffer incomplete, dynamic resolution disabled\n");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        Cleanup();
+        supported = false;
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+    return true;
+}
+
+bool RenderTarget::Begin(int windowWidth, int windowHeight, float scale)
+{
+    if (supported && (width != windowWidth || height != windowHeight)) {
+        Allocate(windowWidth, windowHeight);
+    }
+
+    if (supported == false) {
+        glViewport(0, 0, windowWidth, windowHeight);
+        glClear(GL_COLOR_BUFFER_BIT);
+        return false;
+    }
+
+    viewportWidth = (int)(windowWidth * scale + 0.5f);
+    viewportHeight = (int)(windowHeight * scale + 0.5f);
+    if (viewportWidth < 1) viewportWidth = 1;
+    if (viewportHeight < 1) viewportHeight = 1;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+
+    // Only clear the part we draw into
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, viewportWidth, viewportHeight);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    return true;
+}
+
+void RenderTarget::Resolve()
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    // Every window pixel is written, no need to clear it first
+    GLenum filter = (viewportWidth == width && viewportHeight == height) ? GL_NEAREST : GL_LINEAR;
+    glBlitFramebuffer(0, 0, viewportWidth, viewportHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, filter);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
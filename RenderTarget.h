@@ -0,0 +1,41 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+
+// Offscreen color buffer the world is drawn into before being stretched onto the
+// window. It is allocated at window size once and smaller scales only use its
+// lower left corner, so changing the scale never reallocates.
+class RenderTarget {
+public:
+
+    bool supported = false;
+
+    // Needs a current GL context
+    void Init();
+    void Cleanup();
+
+    // Binds the target with a viewport of scale * window size and clears that area.
+    // Returns false if offscreen rendering is unavailable, the window is cleared
+    // and drawn to directly instead.
+    bool Begin(int windowWidth, int windowHeight, float scale);
+
+    // Stretches what was drawn since Begin over the window and leaves the window bound
+    void Resolve();
+
+private:
+
+    GLuint framebuffer = 0;
+    GLuint colorTexture = 0;
+    int width = 0;
+    int height = 0;
+    int viewportWidth = 0;
+    int viewportHeight = 0;
+
+    bool Allocate(int width, int height);
+};
@@ -0,0 +1,386 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "Renderer.h"
+#include "Trace.h"
+#include "Profiler.h"
+#include "Metrics.h"
+#include "AllocationTracker.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <cstring>
+
+void Renderer::Start(SDL_Window* window, SDL_GLContext context, ShaderProgram* program, bool threaded)
+{
+    this->window = window;
+    this->context = context;
+    this->program = program;
+    this->threaded = threaded;
+
+    if (threaded) {
+        // The context can only be current on one thread at a time
+        SDL_GL_MakeCurrent(window, NULL);
+        thread = std::thread(&Renderer::ThreadMain, this);
+    }
+    else {
+        ApplySwapInterval();
+        gpuTimer.Init();
+        target.Init();
+    }
+}
+
+void Renderer::ApplySwapInterval()
+{
+    if (SDL_GL_SetSwapInterval(swapInterval) == 0) return;
+
+    // Adaptive vsync is an extension, plain vsync is the closest thing
+    if (swapInterval == -1 && SDL_GL_SetSwapInterval(1) == 0) {
+        printf("Adaptive vsync not supported, using vsync\n");
+        return;
+    }
+    printf("Unable to set swap interval %d: %s\n", swapInterval, SDL_GetError());
+}
+
+void Renderer::Stop()
+{
+    if (threaded == false) {
+        gpuTimer.Cleanup();
+        streamer.Cleanup();
+        target.Cleanup();
+        CleanupParticles();
+        return;
+    }
+    if (thread.joinable() == false) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    signal.notify_all();
+    thread.join();
+
+    SDL_GL_MakeCurrent(window, context);
+}
+
+RenderPacket* Renderer::BeginPacket()
+{
+    RenderPacket* packet = &packets[writeIndex];
+    packet->Clear();
+    return packet;
+}
+
+void Renderer::SubmitPacket()
+{
+    if (threaded == false) {
+        DrawPacket(&packets[writeIndex]);
+        return;
+    }
+
+    TRACE_SCOPE("wait for render thread");
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // The other packet is still being drawn, it becomes the next write target
+    signal.wait(lock, [this] { return pendingIndex == -1 && rendering == false; });
+
+    pendingIndex = writeIndex;
+    writeIndex = 1 - writeIndex;
+
+    lock.unlock();
+    signal.notify_all();
+}
+
+void Renderer::ThreadMain()
+{
+    TRACE_THREAD_NAME("render");
+    profiler.RegisterThread("render");
+    SDL_GL_MakeCurrent(window, context);
+    ApplySwapInterval();
+    gpuTimer.Init();
+    target.Init();
+    // Created here rather than by the first text drawn, which is well past the warm up
+    FrameArena::ForThread();
+
+    while (true) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            signal.wait(lock, [this] { return pendingIndex != -1 || quit; });
+            if (pendingIndex == -1) break;
+
+            index = pendingIndex;
+            pendingIndex = -1;
+            rendering = true;
+        }
+
+        DrawPacket(&packets[index]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            rendering = false;
+        }
+        signal.notify_all();
+    }
+
+    gpuTimer.Cleanup();
+    streamer.Cleanup();
+    target.Cleanup();
+    CleanupParticles();
+    SDL_GL_MakeCurrent(window, NULL);
+}
+
+void Renderer::DrawPacket(RenderPacket* packet)
+{
+    ALLOC_FRAME_SCOPE();
+    TRACE_SCOPE("DrawPacket");
+    TRACE_COUNTER("tiles", packet->tiles.size());
+    TRACE_COUNTER("sprites", packet->sprites.size());
+
+    double drawStart = FrameStats::Now();
+    {
+        StatScope timer(STAT_DRAW);
+        TRACE_SCOPE("draw");
+
+        {
+            ALLOC_TAG("texture streaming");
+            streamer.Pump();
+        }
+        // Particles aren't drawn before the first burst, finish their program as soon
+        // as the driver is done instead of in the middle of that frame
+        if (particleProgram != NULL) particleProgram->IsReady();
+
+        int windowWidth, windowHeight;
+        SDL_GL_GetDrawableSize(window, &windowWidth, &windowHeight);
+
+        bool offscreen = false;
+        if (resolution.enabled || resolution.scale != 1.0f) {
+            offscreen = target.Begin(windowWidth, windowHeight, resolution.scale);
+        }
+        else {
+            glViewport(0, 0, windowWidth, windowHeight);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+
+        program->SetProjectionMatrix(packet->projectionMatrix);
+        program->SetViewMatrix(packet->viewMatrix);
+
+        gpuTimer.Begin(GPU_PASS_TILES);
+        DrawSprites(packet->tiles);
+        gpuTimer.End(GPU_PASS_TILES);
+
+        gpuTimer.Begin(GPU_PASS_SPRITES);
+        DrawSprites(packet->sprites);
+        gpuTimer.End(GPU_PASS_SPRITES);
+
+        if (packet->particles.x.empty() == false && particleProgram != NULL) {
+            float viewportHeight = windowHeight * (offscreen ? resolution.scale : 1.0f);
+            gpuTimer.Begin(GPU_PASS_PARTICLES);
+            DrawParticles(packet->particles, packet->projectionMatrix, packet->viewMatrix, viewportHeight);
+            gpuTimer.End(GPU_PASS_PARTICLES);
+        }
+
+        if (offscreen) target.Resolve();
+
+        program->SetProjectionMatrix(packet->hudProjectionMatrix);
+        program->SetViewMatrix(packet->hudViewMatrix);
+
+        gpuTimer.Begin(GPU_PASS_TEXT);
+        for (const TextInstance& text : packet->texts) {
+            DrawText(text);
+        }
+        gpuTimer.End(GPU_PASS_TEXT);
+    }
+
+    double swapStart = FrameStats::Now();
+    {
+        StatScope timer(STAT_SWAP);
+        TRACE_SCOPE("SDL_GL_SwapWindow");
+        SDL_GL_SwapWindow(window);
+    }
+    frameStats.MarkFrameShown();
+
+    // With vsync the swap mostly waits for the display, only count it when it can't
+    double now = FrameStats::Now();
+    double cost = swapStart - drawStart;
+    if (swapInterval == 0) cost = now - drawStart;
+    double gpuWorld = gpuTimer.lastMilliseconds[GPU_PASS_TILES] + gpuTimer.lastMilliseconds[GPU_PASS_SPRITES];
+    if (gpuWorld > cost) cost = gpuWorld;
+
+    bool rescaled = resolution.Update(cost);
+    TRACE_COUNTER("resolution scale", resolution.scale);
+    if (rescaled && frameStats.printEnabled) {
+        printf("Resolution scale %.2f\n", resolution.scale);
+    }
+
+    if (lastPresent != 0) frameStats.Record(STAT_PRESENT_INTERVAL, now - lastPresent);
+    lastPresent = now;
+
+    gpuTimer.EndFrame();
+}
+
+void Renderer::DrawSprites(const FrameVector<SpriteInstance>& sprites)
+{
+    if (sprites.empty()) return;
+
+    float vertices[] = { -0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5 };
+
+    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
+    glEnableVertexAttribArray(program->positionAttribute);
+
+    for (const SpriteInstance& sprite : sprites) {
+        float u = sprite.u, v = sprite.v;
+        float texCoords[] = { u, v + sprite.height, u + sprite.width, v + sprite.height, u + sprite.width, v,
+            u, v + sprite.height, u + sprite.width, v, u, v };
+
+        glm::mat4 modelMatrix = glm::mat4(1.0f);
+        modelMatrix = glm::translate(modelMatrix, sprite.position);
+        program->SetModelMatrix(modelMatrix);
+
+        glBindTexture(GL_TEXTURE_2D, sprite.textureID);
+
+        glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
+        glEnableVertexAttribArray(program->texCoordAttribute);
+
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    glDisableVertexAttribArray(program->positionAttribute);
+    glDisableVertexAttribArray(program->texCoordAttribute);
+
+    // Every call that sets state for a draw counts. The position array's pointer and
+    // enable once, then per sprite the model matrix, the texture bind and the texture
+    // coordinate array's pointer and enable.
+    size_t count = sprites.size();
+    metrics.Add(METRIC_DRAW_CALLS, count);
+    metrics.Add(METRIC_STATE_CHANGES, 2 + count * 4);
+    metrics.Add(METRIC_BYTES_UPLOADED, count * (sizeof(vertices) + sizeof(float) * 12 + sizeof(glm::mat4)));
+}
+
+void Renderer::DrawParticles(const ParticleBatch& particles, const glm::mat4& projection,
+    const glm::mat4& view, float viewportHeight)
+{
+    particleProgram->SetProjectionMatrix(projection);
+    particleProgram->SetViewMatrix(view);
+    particleProgram->SetModelMatrix(glm::mat4(1.0f));
+
+    if (particleBuffer == 0) {
+        glGenBuffers(1, &particleBuffer);
+        const char* names[4] = { "positionX", "positionY", "life", "color" };
+        for (int i = 0; i < 4; i++) {
+            particleAttributes[i] = glGetAttribLocation(particleProgram->programID, names[i]);
+        }
+    }
+
+    size_t count = particles.x.size();
+    size_t floatBytes = count * sizeof(float);
+    size_t colorBytes = count * sizeof(uint32_t);
+
+    // Orphan last frame's storage so the driver never waits on a draw still using it
+    glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, floatBytes * 3 + colorBytes, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, floatBytes, particles.x.data());
+    glBufferSubData(GL_ARRAY_BUFFER, floatBytes, floatBytes, particles.y.data());
+    glBufferSubData(GL_ARRAY_BUFFER, floatBytes * 2, floatBytes, particles.life.data());
+    glBufferSubData(GL_ARRAY_BUFFER, floatBytes * 3, colorBytes, particles.color.data());
+
+    // The three matrices and the buffer bind, then a pointer and enable per array
+    size_t stateChanges = 4;
+    for (int i = 0; i < 3; i++) {
+        if (particleAttributes[i] < 0) continue;
+        glVertexAttribPointer(particleAttributes[i], 1, GL_FLOAT, false, 0, (const void*)(floatBytes * i));
+        glEnableVertexAttribArray(particleAttributes[i]);
+        stateChanges += 2;
+    }
+    if (particleAttributes[3] >= 0) {
+        glVertexAttribPointer(particleAttributes[3], 4, GL_UNSIGNED_BYTE, true, 0, (const void*)(floatBytes * 3));
+        glEnableVertexAttribArray(particleAttributes[3]);
+        stateChanges += 2;
+    }
+
+    // Square points sized in world units, so they shrink with the render scale
+    float pointSize = particles.size * projection[1][1] * 0.5f * viewportHeight;
+    glPointSize(pointSize < 1.0f ? 1.0f : pointSize);
+
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    metrics.Add(METRIC_DRAW_CALLS, 1);
+    // And the point size
+    metrics.Add(METRIC_STATE_CHANGES, stateChanges + 1);
+    metrics.Add(METRIC_BYTES_UPLOADED, floatBytes * 3 + colorBytes);
+
+    for (int i = 0; i < 4; i++) {
+        if (particleAttributes[i] >= 0) glDisableVertexAttribArray(particleAttributes[i]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::CleanupParticles()
+{
+    if (particleBuffer != 0) glDeleteBuffers(1, &particleBuffer);
+    particleBuffer = 0;
+}
+
+void BuildTextVertices(const char* text, size_t length, float size, float spacing,
+    float* vertices, float* texCoords)
+{
+    float width = 1.0f / 16.0f;
+    float height = 1.0f / 16.0f;
+
+    for (size_t i = 0; i < length; i++) {
+
+        int index = (unsigned char)text[i];
+        float offset = (size + spacing) * i;
+        float u = (float)(index % 16) / 16.0f;
+        float v = (float)(index / 16) / 16.0f;
+        const float quad[12] = {
+        offset + (-0.5f * size), 0.5f * size,
+        offset + (-0.5f * size), -0.5f * size,
+        offset + (0.5f * size), 0.5f * size,
+        offset + (0.5f * size), -0.5f * size,
+        offset + (0.5f * size), 0.5f * size,
+        offset + (-0.5f * size), -0.5f * size,
+            };
+        const float coords[12] = {
+            u, v,
+            u, v + height,
+            u + width, v,
+            u + width, v + height,
+            u + width, v,
+            u, v + height,
+            };
+        memcpy(vertices + i * 12, quad, sizeof(quad));
+        memcpy(texCoords + i * 12, coords, sizeof(coords));
+
+    } // end of for loop
+}
+
+void Renderer::DrawText(const TextInstance& text)
+{
+    FrameArena& arena = FrameArena::ForThread();
+    FrameArenaScope scope(arena);
+
+    size_t length = strlen(text.text);
+    float* vertices = arena.AllocateArray<float>(length * 12);
+    float* texCoords = arena.AllocateArray<float>(length * 12);
+    BuildTextVertices(text.text, length, text.size, text.spacing, vertices, texCoords);
+
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    modelMatrix = glm::translate(modelMatrix, text.position);
+    program->SetModelMatrix(modelMatrix);
+
+    glUseProgram(program->programID);
+
+    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
+    glEnableVertexAttribArray(program->positionAttribute);
+
+    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
+    glEnableVertexAttribArray(program->texCoordAttribute);
+
+    glBindTexture(GL_TEXTURE_2D, text.fontTextureID);
+    glDrawArrays(GL_TRIANGLES, 0, (int)(length * 6));
+    metrics.Add(METRIC_DRAW_CALLS, 1);
+    // The model matrix, the program, both arrays' pointer and enable and the texture bind
+    metrics.Add(METRIC_STATE_CHANGES, 7);
+    metrics.Add(METRIC_BYTES_UPLOADED, length * 24 * sizeof(float));
+
+    glDisableVertexAttribArray(program->positionAttribute);
+    glDisableVertexAttribArray(program->texCoordAttribute);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include "ShaderProgram.h"
+#include "RenderPacket.h"
+#include "GpuTimer.h"
+#include "FrameStats.h"
+#include "TextureStreamer.h"
+#include "RenderTarget.h"
+#include "DynamicResolution.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Owns the GL context once Start is called. The simulation writes the next frame
+// into BeginPacket() while the render thread draws the previously submitted one.
+class Renderer {
+public:
+
+    SDL_Window* window = NULL;
+    SDL_GLContext context = NULL;
+    ShaderProgram* program = NULL;
+    // Optional, particles are skipped without it
+    ShaderProgram* particleProgram = NULL;
+    bool threaded = true;
+
+    // SDL swap interval, applied on the thread that owns the context
+    int swapInterval = 1;
+
+    GpuTimer gpuTimer;
+    TextureStreamer streamer;
+
+    // The world is drawn at resolution.scale into target, the HUD at window resolution
+    DynamicResolution resolution;
+
+    void Start(SDL_Window* window, SDL_GLContext context, ShaderProgram* program, bool threaded);
+    void Stop();
+
+    RenderPacket* BeginPacket();
+    void SubmitPacket();
+
+    void DrawPacket(RenderPacket* packet);
+
+private:
+
+    RenderPacket packets[2];
+    int writeIndex = 0;
+    int pendingIndex = -1;
+    bool rendering = false;
+    bool quit = false;
+    double lastPresent = 0;
+    RenderTarget target;
+
+    // Particle arrays are streamed into one buffer each frame
+    GLuint particleBuffer = 0;
+    GLint particleAttributes[4];
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable signal;
+
+    void ThreadMain();
+    void ApplySwapInterval();
+    void DrawSprites(const FrameVector<SpriteInstance>& sprites);
+    void DrawParticles(const ParticleBatch& particles, const glm::mat4& projection,
+        const glm::mat4& view, float viewportHeight);
+    void CleanupParticles();
+    void DrawText(const TextInstance& text);
+};
+
+// Two triangles per character from the 16x16 glyph grid of a font texture,
+// vertices and texCoords need room for 12 floats per character
+void BuildTextVertices(const char* text, size_t length, float size, float spacing,
+    float* vertices, float* texCoords);
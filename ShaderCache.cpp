@@ -0,0 +1,149 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <SDL.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define SHADER_CACHE_VERSION 1
+
+struct ShaderCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
+
+// Empty if neither directory is known, the cache is off then
+static const std::string& CacheDirectory()
+{
+    static const std::string directory = [] {
+        std::string path;
+        char* found = SDL_GetPrefPath(SHADER_CACHE_ORGANIZATION, SHADER_CACHE_APPLICATION);
+        if (found == NULL) found = SDL_GetBasePath();
+        if (found != NULL) {
+            path = found;
+            SDL_free(found);
+        }
+        return path;
+    }();
+    return directory;
+}
+
+static std::string CachePath(uint64_t key)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx.progbin", (unsigned long long)key);
+    return CacheDirectory() + name;
+}
+
+static uint64_t HashString(const char* text, uint64_t seed)
+{
+    if (text == NULL) text = "";
+    // Include the terminator so "ab"+"c" and "a"+"bc" differ
+    return HashBytes(text, strlen(text) + 1, seed);
+}
+
+uint64_t ShaderCacheKey(const char* vertexSource, size_t vertexLength, const char* fragmentSource, size_t fragmentLength)
+{
+    // Lengths go in too so moving text from one stage to the other changes the key
+    uint64_t key = HashBytes(vertexSource, vertexLength);
+    key = HashBytes(&vertexLength, sizeof(vertexLength), key);
+    key = HashBytes(fragmentSource, fragmentLength, key);
+    key = HashBytes(&fragmentLength, sizeof(fragmentLength), key);
+
+    // Binaries are only valid for the driver build that produced them
+    key = HashString((const char*)glGetString(GL_VENDOR), key);
+    key = HashString((const char*)glGetString(GL_RENDERER), key);
+    key = HashString((const char*)glGetString(GL_VERSION), key);
+    return key;
+}
+
+bool ShaderCacheSupported()
+{
+    static int supported = -1;
+    if (supported == -1) {
+        int major = 0, minor = 0;
+        const char* version = (const char*)glGetString(GL_VERSION);
+        if (version != NULL) sscanf(version, "%d.%d", &major, &minor);
+
+        GLint formats = 0;
+        if (major > 4 || (major == 4 && minor >= 1) || SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        }
+        supported = formats > 0 ? 1 : 0;
+    }
+    return supported == 1;
+}
+
+GLuint ShaderCacheLoad(uint64_t key)
+{
+    if (ShaderCacheSupported() == false || CacheDirectory().empty()) return 0;
+
+    FILE* file = fopen(CachePath(key).c_str(), "rb");
+    if (file == NULL) return 0;
+
+    ShaderCacheHeader header;
+    std::vector<unsigned char> binary;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, "SPBC", 4) == 0
+        && header.version == SHADER_CACHE_VERSION
+        && header.key == key
+        && header.binaryLength > 0;
+    if (valid) {
+        binary.resize(header.binaryLength);
+        valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (valid == false) return 0;
+
+    GLuint programID = glCreateProgram();
+    glProgramBinary(programID, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+    return programID;
+}
+
+void ShaderCacheStore(uint64_t key, GLuint programID)
+{
+    if (ShaderCacheSupported() == false || CacheDirectory().empty()) return;
+
+    GLint length = 0;
+    glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<unsigned char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(programID, length, &length, &binaryFormat, binary.data());
+
+    ShaderCacheHeader header;
+    memcpy(header.magic, "SPBC", 4);
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = (uint32_t)length;
+
+    // Write to a temporary name first so a crash never leaves a truncated entry behind
+    std::string path = CachePath(key);
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == NULL) {
+        // Once, every program would say the same
+        static std::atomic<bool> reported(false);
+        if (reported.exchange(true) == false) printf("Unable to write the shader cache in %s\n", CacheDirectory().c_str());
+        return;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(binary.data(), 1, length, file) == (size_t)length;
+    fclose(file);
+
+    remove(path.c_str());
+    if (written == false || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+    }
+}
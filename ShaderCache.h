@@ -0,0 +1,28 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Linked program binaries are kept in the user's preference directory, one file per
+// key, so the cache works whatever the working directory and wherever the game is
+// installed. Falls back to the executable's directory when there is none.
+#define SHADER_CACHE_ORGANIZATION "Thy-Lan Gale"
+#define SHADER_CACHE_APPLICATION "Project 4"
+
+// Key for a program built from these sources on the current driver. Needs a current GL context.
+uint64_t ShaderCacheKey(const char* vertexSource, size_t vertexLength, const char* fragmentSource, size_t fragmentLength);
+
+bool ShaderCacheSupported();
+
+// Returns a program created from the cached binary, or 0 if there is no usable entry.
+// The driver may still reject the binary, check GL_LINK_STATUS before using it.
+GLuint ShaderCacheLoad(uint64_t key);
+
+// Call glProgramParameteri(GL_PROGRAM_BINARY_RETRIEVABLE_HINT) before linking the program
+void ShaderCacheStore(uint64_t key, GLuint programID);
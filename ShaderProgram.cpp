@@ -1,26 +1,125 @@
 #define GL_SILENCE_DEPRECATION
 
 #include "ShaderProgram.h"
+#include "ShaderCache.h"
+#include "AssetPack.h"
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRY *MaxShaderCompilerThreadsProc)(GLuint count);
+
+// Asks the driver to compile on its own threads. Returns false if it can't,
+// in which case compiles still run asynchronously on drivers that defer them.
+static bool ParallelCompileSupported() {
+    static int supported = -1;
+    if (supported == -1) {
+        supported = 0;
+        if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) {
+            MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if (maxThreads == NULL) maxThreads = (MaxShaderCompilerThreadsProc)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB");
+            if (maxThreads != NULL) {
+                maxThreads(0xFFFFFFFF);
+                supported = 1;
+            }
+        }
+    }
+    return supported == 1;
+}
 
 void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
+    BeginLoad(vertexShaderFile, fragmentShaderFile);
+    Finish();
+}
+
+void ShaderProgram::BeginLoad(const char *vertexShaderFile, const char *fragmentShaderFile) {
+    
+    ready = false;
+    ParallelCompileSupported();
+    
+    // Sources point into the asset pack when there is one, nothing is copied
+    if (ReadAsset(vertexShaderFile, &vertexSource) == false) {
+        std::cout << "Error opening shader file:" << vertexShaderFile << std::endl;
+    }
+    if (ReadAsset(fragmentShaderFile, &fragmentSource) == false) {
+        std::cout << "Error opening shader file:" << fragmentShaderFile << std::endl;
+    }
+    cacheKey = ShaderCacheKey((const char*)vertexSource.data, vertexSource.size, (const char*)fragmentSource.data, fragmentSource.size);
+    
+    // A binary linked on a previous run skips compiling and linking entirely
+    vertexShader = 0;
+    fragmentShader = 0;
+    programID = ShaderCacheLoad(cacheKey);
+    fromCache = programID != 0;
     
-    // create the vertex shader
-    vertexShader = LoadShaderFromFile(vertexShaderFile, GL_VERTEX_SHADER);
-    // create the fragment shader
-    fragmentShader = LoadShaderFromFile(fragmentShaderFile, GL_FRAGMENT_SHADER);
+    if (programID == 0) {
+        BeginCompile();
+    }
+}
+
+void ShaderProgram::BeginCompile() {
+    
+    // Nothing here queries compile or link status, that would make the driver finish first
+    vertexShader = SubmitShader((const char*)vertexSource.data, vertexSource.size, GL_VERTEX_SHADER);
+    fragmentShader = SubmitShader((const char*)fragmentSource.data, fragmentSource.size, GL_FRAGMENT_SHADER);
     
     // Create the final shader program from our vertex and fragment shaders
     programID = glCreateProgram();
     glAttachShader(programID, vertexShader);
     glAttachShader(programID, fragmentShader);
+    if (ShaderCacheSupported()) {
+        glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(programID);
+}
+
+bool ShaderProgram::IsReady() {
+    if (ready) return true;
+    
+    // Without the extension there is no way to ask without blocking
+    if (ParallelCompileSupported()) {
+        GLint complete = GL_FALSE;
+        glGetProgramiv(programID, GL_COMPLETION_STATUS_KHR, &complete);
+        if (complete == GL_FALSE) return false;
+    }
+    
+    Finish();
+    return true;
+}
+
+void ShaderProgram::Finish() {
+    if (ready) return;
+    ready = true;
     
     GLint linkSuccess;
     glGetProgramiv(programID, GL_LINK_STATUS, &linkSuccess);
-    if(linkSuccess == GL_FALSE) {
-	printf("Error linking shader program!\n");
+    
+    if (linkSuccess == GL_FALSE && fromCache) {
+        // The driver rejected the cached binary, build it from source after all
+        glDeleteProgram(programID);
+        fromCache = false;
+        BeginCompile();
+        glGetProgramiv(programID, GL_LINK_STATUS, &linkSuccess);
     }
     
+    if (fromCache == false) {
+        PrintShaderLog(vertexShader);
+        PrintShaderLog(fragmentShader);
+        if(linkSuccess == GL_FALSE) {
+            printf("Error linking shader program!\n");
+        }
+        else {
+            ShaderCacheStore(cacheKey, programID);
+        }
+    }
+    
+    vertexSource = AssetData();
+    fragmentSource = AssetData();
+    
     modelMatrixUniform = glGetUniformLocation(programID, "modelMatrix");
     projectionMatrixUniform = glGetUniformLocation(programID, "projectionMatrix");
     viewMatrixUniform = glGetUniformLocation(programID, "viewMatrix");
@@ -39,36 +138,45 @@ void ShaderProgram::Cleanup() {
     glDeleteShader(fragmentShader);
 }
 
-GLuint ShaderProgram::LoadShaderFromFile(const std::string &shaderFile, GLenum type) {
-    //Open a file stream with the file name
-    std::ifstream infile(shaderFile);
-    
-    if(infile.fail()) {
+std::string ShaderProgram::ReadShaderFile(const std::string &shaderFile) {
+    // Comes from the asset pack when there is one, otherwise from disk
+    AssetData asset;
+    if (ReadAsset(shaderFile.c_str(), &asset) == false) {
         std::cout << "Error opening shader file:" << shaderFile << std::endl;
+        return std::string();
     }
-    
-    //Create a string buffer and stream the file to it
-    std::stringstream buffer;
-    buffer << infile.rdbuf();
-    
+    return std::string((const char*)asset.data, asset.size);
+}
+
+GLuint ShaderProgram::LoadShaderFromFile(const std::string &shaderFile, GLenum type) {
     // Load the shader from the contents of the file
-    return LoadShaderFromString(buffer.str(), type);
+    return LoadShaderFromString(ReadShaderFile(shaderFile), type);
 }
 
 GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GLenum type) {
     
+    GLuint shaderID = SubmitShader(shaderContents.c_str(), shaderContents.size(), type);
+    PrintShaderLog(shaderID);
+    
+    // return the shader id
+    return shaderID;
+}
+
+GLuint ShaderProgram::SubmitShader(const char *shaderString, size_t length, GLenum type) {
     
     // Create a shader of specified type
     GLuint shaderID = glCreateShader(type);
-    
-    // Get the pointer to the C string from the STL string
-    const char *shaderString = shaderContents.c_str();
-    GLint shaderStringLength = (GLint) shaderContents.size();
+    GLint shaderStringLength = (GLint) length;
     
     // Set the shader source to the string and compile shader
     glShaderSource(shaderID, 1, &shaderString, &shaderStringLength);
     glCompileShader(shaderID);
     
+    return shaderID;
+}
+
+void ShaderProgram::PrintShaderLog(GLuint shaderID) {
+    
     // Check if the shader compiled properly
     GLint compileSuccess;
     glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compileSuccess);
@@ -79,27 +187,28 @@ GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GL
         glGetShaderInfoLog(shaderID, sizeof(messages), 0, &messages[0]);
         std::cout << messages << std::endl;
     }
-    
-    // return the shader id
-    return shaderID;
 }
 
 void ShaderProgram::SetColor(float r, float g, float b, float a) {
+	Finish();
 	glUseProgram(programID);
 	glUniform4f(colorUniform, r, g, b, a);
 }
 
 void ShaderProgram::SetViewMatrix(const glm::mat4 &matrix) {
+    Finish();
     glUseProgram(programID);
     glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::SetModelMatrix(const glm::mat4 &matrix) {
+    Finish();
     glUseProgram(programID);
     glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::SetProjectionMatrix(const glm::mat4 &matrix) {
+    Finish();
     glUseProgram(programID);
     glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);    
 }
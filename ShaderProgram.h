@@ -4,18 +4,27 @@
 	#include <GL/glew.h>
 #endif
 #define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
 #include <SDL_opengl.h>
+#include <stdint.h>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include "glm/mat4x4.hpp"
+#include "AssetPack.h"
 
 class ShaderProgram {
     public:
 	
 		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
 		void Cleanup();
+	
+		// Load split in two: BeginLoad only submits work to the driver, Finish blocks
+		// until the program is linked. Every setter calls Finish on first use.
+		void BeginLoad(const char *vertexShaderFile, const char *fragmentShaderFile);
+		bool IsReady();
+		void Finish();
 
 		void SetModelMatrix(const glm::mat4 &matrix);
         void SetProjectionMatrix(const glm::mat4 &matrix);
@@ -25,6 +34,10 @@ class ShaderProgram {
 	
         GLuint LoadShaderFromString(const std::string &shaderContents, GLenum type);
         GLuint LoadShaderFromFile(const std::string &shaderFile, GLenum type);
+        std::string ReadShaderFile(const std::string &shaderFile);
+        GLuint SubmitShader(const char *shaderString, size_t length, GLenum type);
+        void PrintShaderLog(GLuint shaderID);
+        void BeginCompile();
     
         GLuint programID;
     
@@ -38,4 +51,10 @@ class ShaderProgram {
     
         GLuint vertexShader;
         GLuint fragmentShader;
+    
+        bool ready = false;
+        bool fromCache = false;
+        uint64_t cacheKey = 0;
+        AssetData vertexSource;
+        AssetData fragmentSource;
 };
@@ -0,0 +1,117 @@
+#include "SpatialGrid.h"
+
+#include <cmath>
+
+SpatialGrid::SpatialGrid(float cellSize) : cellSize(cellSize),
+    cells(0, std::hash<long long>(), std::equal_to<long long>(), CellNodeAllocator<Cell>(&cellPool))
+{
+}
+
+long long SpatialGrid::Key(int x, int y)
+{
+    return ((long long)x << 32) | (unsigned int)y;
+}
+
+SpatialGrid::CellRange SpatialGrid::RangeFor(Entity* entity)
+{
+    CellRange range;
+    range.minX = (int)floorf((entity->position.x - entity->width / 2.0f) / cellSize);
+    range.maxX = (int)floorf((entity->position.x + entity->width / 2.0f) / cellSize);
+    range.minY = (int)floorf((entity->position.y - entity->height / 2.0f) / cellSize);
+    range.maxY = (int)floorf((entity->position.y + entity->height / 2.0f) / cellSize);
+    return range;
+}
+
+void SpatialGrid::AddToCells(Entity* entity, const CellRange& range)
+{
+    for (int y = range.minY; y <= range.maxY; y++) {
+        for (int x = range.minX; x <= range.maxX; x++) {
+            auto cell = cells.find(Key(x, y));
+            if (cell == cells.end()) {
+                cell = cells.emplace(Key(x, y), std::vector<Item>()).first;
+                if (spareItems.empty() == false) {
+                    cell->second.swap(spareItems.back());
+                    spareItems.pop_back();
+                }
+            }
+            cell->second.push_back({ entity, range.minX, range.minY });
+        }
+    }
+}
+
+void SpatialGrid::RemoveFromCells(Entity* entity, const CellRange& range)
+{
+    for (int y = range.minY; y <= range.maxY; y++) {
+        for (int x = range.minX; x <= range.maxX; x++) {
+            auto cell = cells.find(Key(x, y));
+            if (cell == cells.end()) continue;
+
+            std::vector<Item>& items = cell->second;
+            for (size_t i = 0; i < items.size(); i++) {
+                if (items[i].entity == entity) {
+                    items[i] = items.back();
+                    items.pop_back();
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void SpatialGrid::Insert(Entity* entity)
+{
+    if (entries.count(entity)) {
+        Update(entity);
+        return;
+    }
+    CellRange range = RangeFor(entity);
+    entries[entity] = range;
+    AddToCells(entity, range);
+}
+
+void SpatialGrid::Remove(Entity* entity)
+{
+    auto entry = entries.find(entity);
+    if (entry == entries.end()) return;
+
+    RemoveFromCells(entity, entry->second);
+    entries.erase(entry);
+}
+
+void SpatialGrid::Update(Entity* entity)
+{
+    auto entry = entries.find(entity);
+    if (entry == entries.end()) return;
+
+    CellRange range = RangeFor(entity);
+    CellRange& old = entry->second;
+
+    // Most frames an entity stays inside the same cells, nothing to do then
+    if (range.minX == old.minX && range.minY == old.minY && range.maxX == old.maxX && range.maxY == old.maxY) return;
+
+    RemoveFromCells(entity, old);
+    AddToCells(entity, range);
+    old = range;
+}
+
+void SpatialGrid::Prune()
+{
+    for (auto cell = cells.begin(); cell != cells.end();) {
+        if (cell->second.empty() == false) {
+            ++cell;
+            continue;
+        }
+        if (cell->second.capacity() > 0) spareItems.push_back(std::move(cell->second));
+        cell = cells.erase(cell);
+    }
+}
+
+void SpatialGrid::Clear()
+{
+    for (auto& cell : cells) {
+        cell.second.clear();
+        if (cell.second.capacity() > 0) spareItems.push_back(std::move(cell.second));
+    }
+    cells.clear();
+    entries.clear();
+}
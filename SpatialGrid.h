@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Entity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Freed hash nodes, kept for the next node instead of going back to the heap
+struct CellNodePool {
+    void* free = NULL;
+
+    CellNodePool() {}
+    CellNodePool(const CellNodePool&) = delete;
+    CellNodePool& operator=(const CellNodePool&) = delete;
+    ~CellNodePool()
+    {
+        while (free != NULL) {
+            void* next = *(void**)free;
+            ::operator delete(free);
+            free = next;
+        }
+    }
+};
+
+// For the cell map, single nodes come from the pool. Bucket arrays, which the map
+// allocates as arrays of pointers, use the heap as usual.
+template <typename T>
+class CellNodeAllocator {
+public:
+    typedef T value_type;
+
+    CellNodePool* pool;
+
+    CellNodeAllocator(CellNodePool* pool) : pool(pool) {}
+    template <typename U>
+    CellNodeAllocator(const CellNodeAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t count)
+    {
+        if (Pooled(count) && pool->free != NULL) {
+            void* node = pool->free;
+            pool->free = *(void**)node;
+            return (T*)node;
+        }
+        return (T*)::operator new(count * sizeof(T));
+    }
+
+    void deallocate(T* memory, size_t count)
+    {
+        if (Pooled(count) == false) {
+            ::operator delete(memory);
+            return;
+        }
+        *(void**)memory = pool->free;
+        pool->free = memory;
+    }
+
+    template <typename U>
+    bool operator==(const CellNodeAllocator<U>& other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const CellNodeAllocator<U>& other) const { return pool != other.pool; }
+
+private:
+
+    static bool Pooled(size_t count) { return count == 1 && std::is_pointer<T>::value == false; }
+};
+
+// Uniform grid over entity bounding boxes. Entities covering several cells are
+// stored in each of them, Query reports every entity once.
+class SpatialGrid {
+public:
+
+    SpatialGrid(float cellSize = 4.0f);
+
+    void Insert(Entity* entity);
+    void Remove(Entity* entity);
+    void Update(Entity* entity);
+    // Cells stay in the map once emptied, so an entity moving back and forth between
+    // cells allocates nothing. This drops the empty ones, when a chunk unloads. Dropped
+    // cells are recycled, a new cell only allocates when more are in use than ever before.
+    void Prune();
+    void Clear();
+
+    // Works with any vector, including FrameVector for per frame results
+    template <typename Allocator>
+    void Query(float left, float bottom, float right, float top, std::vector<Entity*, Allocator>& results);
+
+    int Count() { return (int)entries.size(); }
+
+private:
+
+    struct CellRange {
+        int minX, minY, maxX, maxY;
+    };
+
+    struct Item {
+        Entity* entity;
+        int minX, minY;
+    };
+
+    typedef std::pair<const long long, std::vector<Item>> Cell;
+
+    float cellSize;
+    // Before cells, which returns its nodes to it when destroyed
+    CellNodePool cellPool;
+    std::unordered_map<long long, std::vector<Item>, std::hash<long long>, std::equal_to<long long>, CellNodeAllocator<Cell>> cells;
+    // Storage of dropped cells, handed to new ones
+    std::vector<std::vector<Item>> spareItems;
+    std::unordered_map<Entity*, CellRange> entries;
+
+    CellRange RangeFor(Entity* entity);
+    void AddToCells(Entity* entity, const CellRange& range);
+    void RemoveFromCells(Entity* entity, const CellRange& range);
+    static long long Key(int x, int y);
+};
+
+template <typename Allocator>
+void SpatialGrid::Query(float left, float bottom, float right, float top, std::vector<Entity*, Allocator>& results)
+{
+    int minX = (int)floorf(left / cellSize);
+    int maxX = (int)floorf(right / cellSize);
+    int minY = (int)floorf(bottom / cellSize);
+    int maxY = (int)floorf(top / cellSize);
+
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            auto cell = cells.find(Key(x, y));
+            if (cell == cells.end()) continue;
+
+            for (const Item& item : cell->second) {
+                // An entity spanning several cells is only reported from the first
+                // cell of its range that lies inside the queried range
+                if (x != std::max(item.minX, minX) || y != std::max(item.minY, minY)) continue;
+
+                Entity* entity = item.entity;
+                if (entity->position.x + entity->width / 2.0f < left) continue;
+                if (entity->position.x - entity->width / 2.0f > right) continue;
+                if (entity->position.y + entity->height / 2.0f < bottom) continue;
+                if (entity->position.y - entity->height / 2.0f > top) continue;
+
+                results.push_back(entity);
+            }
+        }
+    }
+}
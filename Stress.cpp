@@ -0,0 +1,295 @@
+#include "Stress.h"
+#include "Level.h"
+#include "LevelFile.h"
+#include "LevelStreamer.h"
+#include "Camera.h"
+#include "SpatialGrid.h"
+#include "RenderPacket.h"
+#include "HardwareCounters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define STRESS_TIMESTEP 0.0166666f
+// Rows above the floor that floating platforms are scattered over
+#define STRESS_BAND_ROWS 6
+
+struct StressSettings {
+    int tiles = 1000;
+    int enemies[3] = { 100, 100, 100 };  // by AIType
+    float density = 0.25f;
+    int ticks = 600;
+    unsigned seed = 1;
+    bool renderAll = false;
+    bool counters = false;
+    const char* savePath = NULL;
+};
+
+enum StressPhase { PHASE_COLLISION, PHASE_AI, PHASE_INTEGRATION, PHASE_GRID, PHASE_RENDER_SUBMIT, PHASE_COUNT };
+
+static const char* phaseNames[PHASE_COUNT] = { "collision", "ai", "integration", "grid", "render submit" };
+
+// A floor along the whole level with platforms scattered over a band above it.
+// The level is as wide as it needs to be for the tile count at this density.
+static void BuildStressLevel(LevelBuilder* builder, const StressSettings& settings)
+{
+    std::mt19937 random(settings.seed);
+    auto chance = [&]() { return (float)(random() >> 8) / (float)(1 << 24); };
+
+    int columns = (int)ceil(settings.tiles / (1.0f + settings.density * STRESS_BAND_ROWS));
+    if (columns < 10) columns = 10;
+    float left = -5.0f;
+
+    for (int x = 0; x < columns; x++) {
+        builder->tiles.push_back({ left + 0.5f + x, -3.25f });
+    }
+
+    // The rest go to random cells of the band, one clear row above the floor
+    // so enemies spawned on it start free
+    std::vector<LevelTile> band;
+    for (int x = 0; x < columns; x++) {
+        for (int row = 0; row < STRESS_BAND_ROWS; row++) {
+            band.push_back({ left + 0.5f + x, -1.25f + row });
+        }
+    }
+    std::shuffle(band.begin(), band.end(), random);
+    size_t floating = std::min(band.size(), (size_t)std::max(0, settings.tiles - columns));
+    builder->tiles.insert(builder->tiles.end(), band.begin(), band.begin() + floating);
+
+    builder->spawns.push_back(DefaultPlayerSpawn(left + 0.5f, -2.25f));
+    for (int type = 0; type < 3; type++) {
+        for (int i = 0; i < settings.enemies[type]; i++) {
+            float x = left + 1.0f + chance() * (columns - 2);
+            builder->spawns.push_back(DefaultEnemySpawn(x, -2.4f, type));
+        }
+    }
+}
+
+struct PhaseTimes {
+    std::vector<double> ticks[PHASE_COUNT];  // ms per tick
+};
+
+static double Milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static double Percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(fraction * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static bool ParseSettings(int argc, char* argv[], StressSettings* settings)
+{
+    for (int i = 0; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--tiles") == 0 && hasValue) settings->tiles = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--walkers") == 0 && hasValue) settings->enemies[WALKER] = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--jumpers") == 0 && hasValue) settings->enemies[JUMPER] = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--waitandgo") == 0 && hasValue) settings->enemies[WAITANDGO] = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--density") == 0 && hasValue) settings->density = std::min(1.0f, std::max(0.0f, (float)atof(argv[++i])));
+        else if (strcmp(argv[i], "--ticks") == 0 && hasValue) settings->ticks = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) settings->seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--save") == 0 && hasValue) settings->savePath = argv[++i];
+        else if (strcmp(argv[i], "--render-all") == 0) settings->renderAll = true;
+        else if (strcmp(argv[i], "--counters") == 0) settings->counters = true;
+        else return false;
+    }
+    return true;
+}
+
+int RunStress(int argc, char* argv[])
+{
+    StressSettings settings;
+    if (ParseSettings(argc, argv, &settings) == false) {
+        printf("usage: --stress [--tiles n] [--walkers n] [--jumpers n] [--waitandgo n] [--density d]\n"
+               "                [--ticks n] [--seed n] [--render-all] [--counters] [--save out.lvl]\n");
+        return 1;
+    }
+
+    auto buildStart = std::chrono::steady_clock::now();
+    LevelBuilder builder;
+    BuildStressLevel(&builder, settings);
+    Level level;
+    builder.Build(&level);
+    auto buildEnd = std::chrono::steady_clock::now();
+
+    if (settings.savePath != NULL && WriteLevelFile(settings.savePath, level) == false) {
+        printf("Unable to write %s\n", settings.savePath);
+        return 1;
+    }
+
+    // Everything stays loaded, this measures the simulation rather than streaming
+    SpatialGrid renderGrid;
+    SpatialGrid collisionGrid;
+    LevelStreamer streamer;
+    streamer.loadDistance = 1e9f;
+    streamer.unloadDistance = 2e9f;
+    streamer.Start(&level, &renderGrid, &collisionGrid);
+    streamer.Prime(0.0f);
+    auto loadEnd = std::chrono::steady_clock::now();
+
+    const LevelSpawn* spawn = level.FindSpawn(SPAWN_PLAYER);
+    Entity player;
+    player.entityType = PLAYER;
+    player.position = glm::vec3(spawn->x, spawn->y, 0);
+    player.acceleration = glm::vec3(0, -9.81f, 0);
+    player.width = spawn->width;
+    player.height = spawn->height;
+    player.speed = spawn->speed;
+    player.jumpPower = spawn->jumpPower;
+    renderGrid.Insert(&player);
+
+    Camera camera;
+    camera.target = &player;
+    camera.SetBounds(level.left, level.right, -3.75f, 3.75f);
+    camera.SnapToTarget();
+
+    std::vector<Entity*> bodies;
+    bodies.push_back(&player);
+    bodies.insert(bodies.end(), streamer.enemies.begin(), streamer.enemies.end());
+
+    printf("level: %u tiles, %u collision rects, %u chunks, %d enemies, %.0f units wide\n",
+        level.tileCount, level.rectCount, level.chunkCount, (int)streamer.enemies.size(), level.right - level.left);
+    printf("build %.1f ms, load %.1f ms\n", Milliseconds(buildStart, buildEnd), Milliseconds(buildEnd, loadEnd));
+
+    std::vector<Entity*> candidates;
+    std::vector<Entity*> visible;
+    RenderPacket packet;
+    PhaseTimes times;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) times.ticks[phase].reserve(settings.ticks);
+    size_t submitted = 0;
+
+    // Read at each phase boundary between two timestamps. The phase before ends at the
+    // first and the phase after starts at the second, so the read is in neither.
+    HardwareCounters::enabled = settings.counters;
+    HardwareCounters* counters = HardwareCounters::ForThread();
+    CounterSample marks[PHASE_COUNT + 1];
+    CounterSample counted[PHASE_COUNT] = {};
+    std::chrono::steady_clock::time_point ends[PHASE_COUNT + 1], starts[PHASE_COUNT + 1];
+    auto mark = [&](int boundary) {
+        ends[boundary] = std::chrono::steady_clock::now();
+        if (counters != NULL) counters->Read(&marks[boundary]);
+        starts[boundary] = std::chrono::steady_clock::now();
+    };
+
+    // Each phase runs over every entity before the next starts so it can be timed on
+    // its own. The work is what Entity::Update does, only enemies see the player's
+    // position from the end of the previous tick rather than this one.
+    for (int tick = 0; tick < settings.ticks; tick++) {
+        // Run right and hop, so the camera and the player's collisions keep changing
+        player.movement = glm::vec3(1.0f, 0, 0);
+        if (player.collidedBottom && tick % 60 == 0) player.jump = true;
+
+        mark(0);
+        for (Entity* entity : bodies) {
+            if (entity->isActive == false) continue;
+            entity->BeginUpdate(STRESS_TIMESTEP);
+
+            float margin = 1.0f;
+            candidates.clear();
+            collisionGrid.Query(entity->position.x - entity->width / 2.0f - margin, entity->position.y - entity->height / 2.0f - margin,
+                entity->position.x + entity->width / 2.0f + margin, entity->position.y + entity->height / 2.0f + margin, candidates);
+            entity->CheckCollisionsY(candidates.data(), (int)candidates.size());
+            entity->CheckCollisionsX(candidates.data(), (int)candidates.size());
+        }
+
+        mark(1);
+        for (Entity* entity : bodies) {
+            if (entity->isActive && entity->entityType == ENEMY) entity->AI(&player);
+        }
+
+        mark(2);
+        for (Entity* entity : bodies) {
+            if (entity->isActive) entity->Integrate(STRESS_TIMESTEP);
+        }
+        camera.Update(STRESS_TIMESTEP);
+
+        mark(3);
+        for (Entity* entity : bodies) {
+            renderGrid.Update(entity);
+        }
+
+        mark(4);
+        packet.tiles.clear();
+        packet.sprites.clear();
+        float left, bottom, right, top;
+        if (settings.renderAll) {
+            left = level.left - 1.0f;
+            right = level.right + 1.0f;
+            bottom = level.bottom - 100.0f;
+            top = level.top + 100.0f;
+        }
+        else {
+            camera.GetVisibleRect(&left, &bottom, &right, &top);
+        }
+        visible.clear();
+        renderGrid.Query(left, bottom, right, top, visible);
+        for (Entity* entity : visible) {
+            entity->Render(&packet);
+        }
+        submitted += packet.tiles.size() + packet.sprites.size();
+
+        mark(5);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            times.ticks[phase].push_back(Milliseconds(starts[phase], ends[phase + 1]));
+            AddCounterDelta(marks[phase], marks[phase + 1], &counted[phase]);
+        }
+    }
+
+    printf("%d ticks, %zu bodies, %.0f sprites submitted per tick\n\n", settings.ticks, bodies.size(),
+        (double)submitted / settings.ticks);
+    printf("%-16s %10s %10s %10s %10s %12s\n", "phase (ms)", "mean", "median", "p99", "max", "ns/entity");
+
+    double totalMean = 0;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        const std::vector<double>& values = times.ticks[phase];
+        double sum = 0;
+        for (double value : values) sum += value;
+        double mean = sum / values.size();
+        totalMean += mean;
+
+        // Per simulated body, except render submission which scales with what is visible
+        double perEntity = phase == PHASE_RENDER_SUBMIT
+            ? (submitted > 0 ? sum * 1e6 / submitted : 0)
+            : mean * 1e6 / bodies.size();
+        printf("%-16s %10.3f %10.3f %10.3f %10.3f %12.1f\n", phaseNames[phase], mean,
+            Percentile(values, 0.5), Percentile(values, 0.99), Percentile(values, 1.0), perEntity);
+    }
+    printf("%-16s %10.3f\n", "total", totalMean);
+
+    if (counters != NULL) {
+        printf("\n%-16s", "per entity");
+        for (int c = 0; c < COUNTER_COUNT; c++) printf(" %13s", HardwareCounters::Name((HardwareCounter)c));
+        printf(" %6s\n", "ipc");
+
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            // Same units as ns/entity above
+            double items = phase == PHASE_RENDER_SUBMIT ? (double)submitted : (double)bodies.size() * settings.ticks;
+            const uint64_t* values = counted[phase].values;
+            printf("%-16s", phaseNames[phase]);
+            for (int c = 0; c < COUNTER_COUNT; c++) {
+                if (HardwareCounters::Available((HardwareCounter)c) && items > 0) printf(" %13.2f", values[c] / items);
+                else printf(" %13s", "-");
+            }
+            if (values[COUNTER_CYCLES] > 0 && HardwareCounters::Available(COUNTER_INSTRUCTIONS)) {
+                printf(" %6.2f\n", (double)values[COUNTER_INSTRUCTIONS] / (double)values[COUNTER_CYCLES]);
+            }
+            else {
+                printf(" %6s\n", "-");
+            }
+        }
+    }
+
+    streamer.Stop();
+    return 0;
+}
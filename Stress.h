@@ -0,0 +1,9 @@
+#pragma once
+
+// --stress [--tiles n] [--walkers n] [--jumpers n] [--waitandgo n] [--density d]
+//          [--ticks n] [--seed n] [--render-all] [--counters] [--save out.lvl]
+// Generates a level of the requested size, loads all of it and runs the simulation
+// headless for a fixed number of ticks, timing each phase of the update separately.
+// Density is the share of cells filled with floating platforms above the floor.
+// --counters adds CPU counters per entity and phase where perf_event_open works.
+int RunStress(int argc, char* argv[]);
@@ -0,0 +1,261 @@
+#include "TextureCooker.h"
+#include "TextureFile.h"
+#include "AssetPack.h"
+#include "Hash.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct MipLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+// 2x2 box filter. Colors are weighted by alpha so transparent texels don't darken edges.
+static void Downsample(const MipLevel& source, MipLevel* target)
+{
+    target->width = source.width > 1 ? source.width / 2 : 1;
+    target->height = source.height > 1 ? source.height / 2 : 1;
+    target->pixels.resize(target->width * target->height * 4);
+
+    for (int y = 0; y < target->height; y++) {
+        for (int x = 0; x < target->width; x++) {
+            int color[3] = { 0, 0, 0 };
+            int alpha = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int sx = std::min(x * 2 + dx, source.width - 1);
+                    int sy = std::min(y * 2 + dy, source.height - 1);
+                    const unsigned char* p = &source.pixels[(sy * source.width + sx) * 4];
+                    for (int c = 0; c < 3; c++) color[c] += p[c] * p[3];
+                    alpha += p[3];
+                }
+            }
+            unsigned char* out = &target->pixels[(y * target->width + x) * 4];
+            for (int c = 0; c < 3; c++) out[c] = alpha > 0 ? (unsigned char)(color[c] / alpha) : 0;
+            out[3] = (unsigned char)((alpha + 2) / 4);
+        }
+    }
+}
+
+static unsigned short To565(const int* color)
+{
+    return (unsigned short)(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+}
+
+static void From565(unsigned short packed, int* color)
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// Encodes one 4x4 block. Endpoints come from the color bounding box, slightly inset.
+// Blocks with transparent texels use the 3 color mode where index 3 is transparent.
+static void EncodeBlockBC1(const unsigned char block[16][4], unsigned char* out)
+{
+    int minColor[3] = { 255, 255, 255 };
+    int maxColor[3] = { 0, 0, 0 };
+    bool transparent = false;
+    bool anyOpaque = false;
+
+    for (int i = 0; i < 16; i++) {
+        if (block[i][3] < 128) {
+            transparent = true;
+            continue;
+        }
+        anyOpaque = true;
+        for (int c = 0; c < 3; c++) {
+            minColor[c] = std::min(minColor[c], (int)block[i][c]);
+            maxColor[c] = std::max(maxColor[c], (int)block[i][c]);
+        }
+    }
+
+    if (anyOpaque == false) {
+        // c0 <= c1 selects 3 color mode, all indices 3 = fully transparent
+        memset(out, 0, 4);
+        memset(out + 4, 0xFF, 4);
+        return;
+    }
+
+    for (int c = 0; c < 3; c++) {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+
+    unsigned short c0 = To565(maxColor);
+    unsigned short c1 = To565(minColor);
+    if (transparent) {
+        if (c0 > c1) std::swap(c0, c1);
+    }
+    else {
+        if (c0 < c1) std::swap(c0, c1);
+        // Equal endpoints would switch to 3 color mode, any index 0 still decodes to c0
+    }
+
+    int palette[4][3];
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    int paletteSize;
+    if (c0 > c1) {
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        paletteSize = 4;
+    }
+    else {
+        for (int c = 0; c < 3; c++) palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+        paletteSize = 3;
+    }
+
+    unsigned int indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 3;
+        if (transparent == false || block[i][3] >= 128) {
+            int bestError = 0x7FFFFFFF;
+            for (int p = 0; p < paletteSize; p++) {
+                int error = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = (int)block[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    best = p;
+                }
+            }
+        }
+        indices |= (unsigned int)best << (i * 2);
+    }
+
+    out[0] = (unsigned char)(c0 & 0xFF);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; i++) out[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+static void EncodeBC1(const MipLevel& level, std::vector<unsigned char>* out)
+{
+    int blocksX = (level.width + 3) / 4;
+    int blocksY = (level.height + 3) / 4;
+    out->resize(blocksX * blocksY * 8);
+
+    unsigned char block[16][4];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            // Edge blocks of small mips repeat the last row/column
+            for (int i = 0; i < 16; i++) {
+                int x = std::min(bx * 4 + i % 4, level.width - 1);
+                int y = std::min(by * 4 + i / 4, level.height - 1);
+                memcpy(block[i], &level.pixels[(y * level.width + x) * 4], 4);
+            }
+            EncodeBlockBC1(block, &(*out)[(by * blocksX + bx) * 8]);
+        }
+    }
+}
+
+static bool CookTexture(const char* sourcePath, bool compress)
+{
+    MipLevel base;
+    int n;
+    AssetData source;
+    unsigned char* image = NULL;
+    if (ReadAsset(sourcePath, &source)) {
+        image = stbi_load_from_memory(source.data, (int)source.size, &base.width, &base.height, &n, STBI_rgb_alpha);
+    }
+    if (image == NULL) {
+        printf("%s: unable to load image\n", sourcePath);
+        return false;
+    }
+    base.pixels.assign(image, image + base.width * base.height * 4);
+    stbi_image_free(image);
+
+    std::vector<MipLevel> mips(1, base);
+    while ((mips.back().width > 1 || mips.back().height > 1) && mips.size() < TEXTURE_FILE_MAX_LEVELS) {
+        MipLevel next;
+        Downsample(mips.back(), &next);
+        mips.push_back(next);
+    }
+
+    // Drivers only reliably accept S3TC when the top level is made of whole blocks
+    if (compress && (base.width % 4 != 0 || base.height % 4 != 0)) {
+        printf("%s: %dx%d is not a multiple of 4, storing uncompressed\n", sourcePath, base.width, base.height);
+        compress = false;
+    }
+
+    TextureFileHeader header;
+    memcpy(header.magic, "CTEX", 4);
+    header.version = TEXTURE_FILE_VERSION;
+    header.format = compress ? TEXTURE_FORMAT_BC1 : TEXTURE_FORMAT_RGBA8;
+    header.width = base.width;
+    header.height = base.height;
+    header.levelCount = (uint32_t)mips.size();
+    header.sourceHash = HashBytes(source.data, source.size);
+
+    std::vector<TextureFileLevel> levels(mips.size());
+    std::vector<std::vector<unsigned char>> payloads(mips.size());
+    size_t offset = sizeof(TextureFileHeader) + levels.size() * sizeof(TextureFileLevel);
+
+    for (size_t i = 0; i < mips.size(); i++) {
+        if (compress) EncodeBC1(mips[i], &payloads[i]);
+        else payloads[i].swap(mips[i].pixels);
+
+        offset = (offset + TEXTURE_FILE_ALIGNMENT - 1) / TEXTURE_FILE_ALIGNMENT * TEXTURE_FILE_ALIGNMENT;
+        levels[i].offset = (uint32_t)offset;
+        levels[i].size = (uint32_t)payloads[i].size();
+        levels[i].width = mips[i].width;
+        levels[i].height = mips[i].height;
+        offset += payloads[i].size();
+    }
+
+    std::vector<unsigned char> file(offset, 0);
+    memcpy(file.data(), &header, sizeof(header));
+    memcpy(file.data() + sizeof(header), levels.data(), levels.size() * sizeof(TextureFileLevel));
+    for (size_t i = 0; i < levels.size(); i++) {
+        memcpy(file.data() + levels[i].offset, payloads[i].data(), payloads[i].size());
+    }
+
+    std::string cookedPath = CookedTexturePath(sourcePath);
+    FILE* out = fopen(cookedPath.c_str(), "wb");
+    if (out == NULL || fwrite(file.data(), 1, file.size(), out) != file.size()) {
+        printf("%s: unable to write\n", cookedPath.c_str());
+        if (out != NULL) fclose(out);
+        return false;
+    }
+    fclose(out);
+
+    printf("%s -> %s: %dx%d, %d levels, %s, %d bytes on GPU (RGBA8 level 0 only: %d)\n", sourcePath, cookedPath.c_str(),
+        base.width, base.height, (int)levels.size(), compress ? "BC1" : "RGBA8",
+        (int)(offset - levels[0].offset), base.width * base.height * 4);
+    return true;
+}
+
+int CookTextures(int argc, char* argv[])
+{
+    bool compress = false;
+    int failures = 0;
+    int cooked = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--compress") == 0) {
+            compress = true;
+            continue;
+        }
+        if (CookTexture(argv[i], compress)) cooked++;
+        else failures++;
+    }
+
+    if (cooked + failures == 0) {
+        printf("usage: --cook-textures [--compress] file.png...\n");
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// --cook-textures [--compress] file.png...
+// Converts each PNG into a .ctex next to it with a prebuilt mip chain, BC1
+// compressed when asked and the size allows it. LoadTexture picks these up.
+int CookTextures(int argc, char* argv[]);
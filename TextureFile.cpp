@@ -0,0 +1,104 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureFile.h"
+#include "Metrics.h"
+
+#include <SDL.h>
+
+#include <cstring>
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+
+bool ParseTextureFile(const unsigned char* data, size_t size, TextureFileView* view)
+{
+    if (size < sizeof(TextureFileHeader)) return false;
+
+    const TextureFileHeader* header = (const TextureFileHeader*)data;
+    if (memcmp(header->magic, "CTEX", 4) != 0 || header->version != TEXTURE_FILE_VERSION) return false;
+    if (header->levelCount == 0 || header->levelCount > TEXTURE_FILE_MAX_LEVELS) return false;
+    if (header->format != TEXTURE_FORMAT_RGBA8 && header->format != TEXTURE_FORMAT_BC1) return false;
+
+    size_t tableEnd = sizeof(TextureFileHeader) + header->levelCount * sizeof(TextureFileLevel);
+    if (size < tableEnd) return false;
+
+    if (header->width == 0 || header->height == 0) return false;
+
+    // Uploads index levels from the first offset, so they must follow the table and
+    // each other in order, and every level halves the one before like the cooker makes them
+    const TextureFileLevel* levels = (const TextureFileLevel*)(data + sizeof(TextureFileHeader));
+    size_t previousEnd = tableEnd;
+    uint32_t width = header->width;
+    uint32_t height = header->height;
+    for (uint32_t i = 0; i < header->levelCount; i++) {
+        const TextureFileLevel& level = levels[i];
+        if (level.width != width || level.height != height) return false;
+        size_t expected = header->format == TEXTURE_FORMAT_BC1
+            ? (size_t)((level.width + 3) / 4) * ((level.height + 3) / 4) * 8
+            : (size_t)level.width * level.height * 4;
+        if (level.size != expected || level.offset < previousEnd || level.offset > size || level.size > size - level.offset) return false;
+
+        previousEnd = (size_t)level.offset + level.size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    view->header = header;
+    view->levels = levels;
+    view->data = data;
+    return true;
+}
+
+bool TextureFormatSupported(uint32_t format)
+{
+    if (format == TEXTURE_FORMAT_BC1) {
+        static int s3tc = -1;
+        if (s3tc == -1) s3tc = SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") ? 1 : 0;
+        return s3tc == 1;
+    }
+    return true;
+}
+
+void UploadTextureLevels(uint32_t format, uint32_t levelCount, const TextureFileLevel* levels, const unsigned char* data)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    for (uint32_t i = 0; i < levelCount; i++) {
+        const TextureFileLevel& level = levels[i];
+        const unsigned char* pixels = data + level.offset;
+        metrics.Add(METRIC_BYTES_UPLOADED, level.size);
+
+        if (format == TEXTURE_FORMAT_BC1) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, level.width, level.height, 0, level.size, pixels);
+        }
+        else {
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+GLuint UploadTextureFile(const TextureFileView& view)
+{
+    const TextureFileHeader* header = view.header;
+    if (TextureFormatSupported(header->format) == false) return 0;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    UploadTextureLevels(header->format, header->levelCount, view.levels, view.data);
+    return textureID;
+}
+
+std::string CookedTexturePath(const char* sourcePath)
+{
+    std::string path = sourcePath;
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) path.erase(dot);
+    return path + TEXTURE_FILE_EXTENSION;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Cooked texture container written by --cook-textures. Levels are stored largest
+// first, already in the format the GPU consumes, each at a TEXTURE_FILE_ALIGNMENT offset.
+#define TEXTURE_FILE_VERSION 2
+#define TEXTURE_FILE_ALIGNMENT 16
+#define TEXTURE_FILE_MAX_LEVELS 16
+#define TEXTURE_FILE_EXTENSION ".ctex"
+
+enum TextureFileFormat {
+    TEXTURE_FORMAT_RGBA8 = 0,
+    // S3TC DXT1 with 1-bit alpha, 8 bytes per 4x4 block
+    TEXTURE_FORMAT_BC1 = 1
+};
+
+struct TextureFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    // HashBytes of the PNG it was cooked from, a different source means it is stale
+    uint64_t sourceHash;
+};
+
+static_assert(sizeof(TextureFileHeader) == 32, "TextureFileHeader layout changed");
+
+struct TextureFileLevel {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+// Points into the file bytes, nothing is copied
+struct TextureFileView {
+    const TextureFileHeader* header;
+    const TextureFileLevel* levels;
+    const unsigned char* data;
+};
+
+bool ParseTextureFile(const unsigned char* data, size_t size, TextureFileView* view);
+
+// These need a current GL context
+bool TextureFormatSupported(uint32_t format);
+
+// Defines every level of the bound texture. With a GL_PIXEL_UNPACK_BUFFER bound,
+// pass data = NULL and the level offsets are read as offsets into the buffer.
+void UploadTextureLevels(uint32_t format, uint32_t levelCount, const TextureFileLevel* levels, const unsigned char* data);
+
+// Returns 0 if the GPU can't take the stored format
+GLuint UploadTextureFile(const TextureFileView& view);
+
+// "player.png" -> "player.ctex"
+std::string CookedTexturePath(const char* sourcePath);
@@ -0,0 +1,244 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureLoader.h"
+#include "Hash.h"
+#include "stb_image.h"
+#include "Trace.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
+
+#include <cassert>
+#include <iostream>
+
+TextureLoader textureLoader;
+
+void TextureLoader::Start(int workerCount)
+{
+    if (workerCount <= 0) {
+        // Leave a core for the main thread, it is busy creating the window meanwhile
+        int cores = (int)std::thread::hardware_concurrency();
+        workerCount = cores > 2 ? cores - 1 : 1;
+        if (workerCount > 4) workerCount = 4;
+    }
+
+    quit = false;
+    for (int i = 0; i < workerCount; i++) {
+        workers.push_back(std::thread(&TextureLoader::WorkerMain, this));
+    }
+}
+
+void TextureLoader::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    jobAdded.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+
+    for (std::unique_ptr<Job>& job : jobs) {
+        if (job->pixels != NULL) stbi_image_free(job->pixels);
+        job->pixels = NULL;
+    }
+}
+
+int TextureLoader::Request(const char* path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (int i = 0; i < (int)jobs.size(); i++) {
+        if (jobs[i]->path == path) return i;
+    }
+
+    jobs.push_back(std::unique_ptr<Job>(new Job()));
+    Job* job = jobs.back().get();
+    job->path = path;
+    queue.push_back(job);
+
+    // Without workers the decode happens in Upload instead
+    if (workers.empty() == false) jobAdded.notify_one();
+    return (int)jobs.size() - 1;
+}
+
+bool TextureLoader::IsDecoded(int handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs[handle]->decoded;
+}
+
+bool TextureLoader::HasFailed(int handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs[handle]->decoded && jobs[handle]->failed;
+}
+
+void TextureLoader::WorkerMain()
+{
+    TRACE_THREAD_NAME("texture loader");
+    profiler.RegisterThread("texture loader");
+    ALLOC_TAG("texture decode");
+    while (true) {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [this] { return queue.empty() == false || quit; });
+            if (quit) return;
+
+            job = queue.front();
+            queue.pop_front();
+        }
+
+        {
+            TRACE_SCOPE("decode");
+            Decode(job);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->decoded = true;
+        }
+        jobDone.notify_all();
+    }
+}
+
+void TextureLoader::Decode(Job* job)
+{
+    AssetData source;
+    bool haveSource = ReadAsset(job->path.c_str(), &source);
+
+    // A cooked texture needs no decoding, only validating and, when the source is
+    // around, checking it was cooked from the source as it is now
+    if (job->sourceOnly == false && ReadAsset(CookedTexturePath(job->path.c_str()).c_str(), &job->cooked)) {
+        job->isCooked = ParseTextureFile(job->cooked.data, job->cooked.size, &job->view);
+        if (job->isCooked && haveSource && job->view.header->sourceHash != HashBytes(source.data, source.size)) {
+            job->isCooked = false;
+            std::cout << "Cooked texture for " << job->path << " is out of date, loading the PNG instead\n";
+        }
+        else if (job->isCooked == false) {
+            std::cout << "Ignoring invalid cooked texture for " << job->path << "\n";
+        }
+        if (job->isCooked) return;
+        job->cooked = AssetData();
+    }
+
+    if (haveSource) {
+        int n;
+        job->pixels = stbi_load_from_memory(source.data, (int)source.size, &job->width, &job->height, &n, STBI_rgb_alpha);
+    }
+    job->failed = job->pixels == NULL;
+}
+
+GLuint TextureLoader::Upload(int handle)
+{
+    Job* job;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job = jobs[handle].get();
+
+        if (workers.empty() && job->decoded == false) {
+            // Nobody else is going to decode it
+            for (size_t i = 0; i < queue.size(); i++) {
+                if (queue[i] == job) {
+                    queue.erase(queue.begin() + i);
+                    break;
+                }
+            }
+            lock.unlock();
+            Decode(job);
+            lock.lock();
+            job->decoded = true;
+        }
+        jobDone.wait(lock, [job] { return job->decoded; });
+    }
+
+    if (job->textureID != 0) return job->textureID;
+
+    // This waits anyway, so the fallback to the source image is decoded right here
+    if (job->isCooked && TextureFormatSupported(job->view.header->format) == false) {
+        job->isCooked = false;
+        job->cooked = AssetData();
+        job->sourceOnly = true;
+        Decode(job);
+    }
+    if (job->failed) {
+        std::cout << "Unable to load image. Make sure the path is correct\n";
+        assert(false);
+        return 0;
+    }
+
+    TextureImage image;
+    ImageFor(job, &image);
+
+    glGenTextures(1, &job->textureID);
+    glBindTexture(GL_TEXTURE_2D, job->textureID);
+    UploadTextureLevels(image.format, image.levelCount, image.levels, image.data);
+
+    ReleaseImage(handle);
+    return job->textureID;
+}
+
+bool TextureLoader::GetImage(int handle, TextureImage* image)
+{
+    Job* job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = jobs[handle].get();
+        if (job->decoded == false || job->failed) return false;
+
+        if (job->isCooked && TextureFormatSupported(job->view.header->format) == false) {
+            // Decoding the source here would stall the frame, a worker does it instead
+            job->isCooked = false;
+            job->cooked = AssetData();
+            job->sourceOnly = true;
+            job->decoded = false;
+            queue.push_back(job);
+            if (workers.empty() == false) jobAdded.notify_one();
+            return false;
+        }
+    }
+    ImageFor(job, image);
+    return true;
+}
+
+void TextureLoader::ReleaseImage(int handle)
+{
+    Job* job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = jobs[handle].get();
+    }
+    job->cooked = AssetData();
+    if (job->pixels != NULL) stbi_image_free(job->pixels);
+    job->pixels = NULL;
+}
+
+// The job must be decoded and not have failed
+void TextureLoader::ImageFor(Job* job, TextureImage* image)
+{
+    if (job->isCooked) {
+        const TextureFileHeader* header = job->view.header;
+        const TextureFileLevel* levels = job->view.levels;
+        uint32_t first = levels[0].offset;
+        uint32_t last = levels[header->levelCount - 1].offset + levels[header->levelCount - 1].size;
+
+        image->format = header->format;
+        image->levelCount = header->levelCount;
+        for (uint32_t i = 0; i < header->levelCount; i++) {
+            image->levels[i] = levels[i];
+            image->levels[i].offset -= first;
+        }
+        image->data = job->view.data + first;
+        image->size = last - first;
+        return;
+    }
+
+    image->format = TEXTURE_FORMAT_RGBA8;
+    image->levelCount = 1;
+    image->levels[0].offset = 0;
+    image->levels[0].size = job->width * job->height * 4;
+    image->levels[0].width = job->width;
+    image->levels[0].height = job->height;
+    image->data = job->pixels;
+    image->size = image->levels[0].size;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include "AssetPack.h"
+#include "TextureFile.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A decoded texture ready to hand to the GPU. Level offsets are relative to data.
+struct TextureImage {
+    uint32_t format;
+    uint32_t levelCount;
+    TextureFileLevel levels[TEXTURE_FILE_MAX_LEVELS];
+    const unsigned char* data;
+    size_t size;
+};
+
+// Decodes textures on worker threads. Request can be called before there is a
+// GL context, Upload runs on the GL thread and only waits for the one it needs.
+class TextureLoader {
+public:
+
+    void Start(int workerCount = 0);
+    void Stop();
+
+    int Request(const char* path);
+    bool IsDecoded(int handle);
+    // Decoded, but there was nothing usable, the file is missing or broken
+    bool HasFailed(int handle);
+
+    // Synchronous upload, waits for the decode if it is still running
+    GLuint Upload(int handle);
+
+    // For uploaders that manage their own transfers. GetImage needs the GL
+    // thread and returns false until the decode is done, or if it failed. A cooked
+    // format the GPU can't take is sent back to a worker to decode the source image.
+    bool GetImage(int handle, TextureImage* image);
+    void ReleaseImage(int handle);
+
+private:
+
+    struct Job {
+        std::string path;
+        bool decoded = false;
+        bool failed = false;
+        // Skip the cooked texture, the GPU can't take its format
+        bool sourceOnly = false;
+        GLuint textureID = 0;
+
+        // Either a cooked .ctex straight from the asset...
+        AssetData cooked;
+        TextureFileView view;
+        bool isCooked = false;
+
+        // ...or pixels decoded by stb_image
+        unsigned char* pixels = NULL;
+        int width = 0;
+        int height = 0;
+    };
+
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::deque<Job*> queue;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDone;
+    bool quit = false;
+
+    void WorkerMain();
+    void Decode(Job* job);
+    void ImageFor(Job* job, TextureImage* image);
+};
+
+extern TextureLoader textureLoader;
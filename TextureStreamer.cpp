@@ -0,0 +1,181 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureStreamer.h"
+#include "TextureLoader.h"
+
+#include <SDL.h>
+
+#include <cstdio>
+#include <cstring>
+
+StreamedTexture* TextureStreamer::Request(const char* path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (std::unique_ptr<StreamedTexture>& texture : textures) {
+        if (texture->path == path) return texture.get();
+    }
+
+    textures.push_back(std::unique_ptr<StreamedTexture>(new StreamedTexture()));
+    StreamedTexture* texture = textures.back().get();
+    texture->path = path;
+
+    Upload upload;
+    upload.texture = texture;
+    upload.loaderHandle = textureLoader.Request(path);
+    uploads.push_back(upload);
+    return texture;
+}
+
+int TextureStreamer::AcquireBuffer(size_t size)
+{
+    int best = -1;
+    for (int i = 0; i < (int)pool.size(); i++) {
+        if (pool[i].busy) continue;
+        if (best == -1 || (pool[i].capacity >= size && pool[best].capacity < size)) best = i;
+    }
+
+    if (best == -1) {
+        if ((int)pool.size() >= maxPixelBuffers) return -1;
+        pool.push_back(PixelBuffer());
+        best = (int)pool.size() - 1;
+        glGenBuffers(1, &pool[best].bufferID);
+    }
+
+    PixelBuffer& buffer = pool[best];
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.bufferID);
+    if (buffer.capacity < size) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        buffer.capacity = size;
+    }
+    buffer.busy = true;
+    return best;
+}
+
+GLuint TextureStreamer::Placeholder()
+{
+    if (placeholderID != 0) return placeholderID;
+
+    // Magenta and black checks, hard to mistake for real art
+    static const unsigned char pixels[] = {
+        255, 0, 255, 255,   0, 0, 0, 255,
+        0, 0, 0, 255,       255, 0, 255, 255
+    };
+    glGenTextures(1, &placeholderID);
+    glBindTexture(GL_TEXTURE_2D, placeholderID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return placeholderID;
+}
+
+bool TextureStreamer::Start(Upload& upload, size_t* budget)
+{
+    TextureImage image;
+    if (textureLoader.GetImage(upload.loaderHandle, &image) == false) return false;
+
+    // Always let one upload through, even one bigger than the whole budget
+    if (image.size > *budget && *budget != uploadBudget) return false;
+
+    upload.buffer = AcquireBuffer(image.size);
+    if (upload.buffer == -1) return false;
+
+    // Invalidating lets the driver hand out fresh memory instead of waiting on the old contents
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped == NULL) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pool[upload.buffer].busy = false;
+        upload.buffer = -1;
+        return false;
+    }
+    memcpy(mapped, image.data, image.size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    textureLoader.ReleaseImage(upload.loaderHandle);
+
+    glGenTextures(1, &upload.textureID);
+    glBindTexture(GL_TEXTURE_2D, upload.textureID);
+    UploadTextureLevels(image.format, image.levelCount, image.levels, NULL);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    *budget = image.size < *budget ? *budget - image.size : 0;
+    return true;
+}
+
+bool TextureStreamer::Finish(Upload& upload)
+{
+    GLenum status = glClientWaitSync(upload.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+    glDeleteSync(upload.fence);
+    upload.fence = 0;
+    pool[upload.buffer].busy = false;
+    upload.texture->textureID = upload.textureID;
+    return true;
+}
+
+void TextureStreamer::Pump()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (uploads.empty()) return;
+
+    if (supported == -1) {
+        int major = 0, minor = 0;
+        const char* version = (const char*)glGetString(GL_VERSION);
+        if (version != NULL) sscanf(version, "%d.%d", &major, &minor);
+        supported = (major > 3 || (major == 3 && minor >= 2)) ? 1 : 0;
+    }
+
+    size_t budget = uploadBudget;
+    for (size_t i = 0; i < uploads.size();) {
+        Upload& upload = uploads[i];
+
+        // Retrying would never get further, each upload is only here once
+        if (upload.fence == 0 && textureLoader.HasFailed(upload.loaderHandle)) {
+            printf("Unable to stream %s, drawing a placeholder instead\n", upload.texture->path.c_str());
+            upload.texture->textureID = Placeholder();
+            uploads.erase(uploads.begin() + i);
+            continue;
+        }
+
+        if (supported == 0) {
+            // No buffer objects or fences, at least keep it off the simulation thread
+            if (textureLoader.IsDecoded(upload.loaderHandle) == false) {
+                i++;
+                continue;
+            }
+            upload.texture->textureID = textureLoader.Upload(upload.loaderHandle);
+            uploads.erase(uploads.begin() + i);
+            continue;
+        }
+
+        if (upload.fence == 0) {
+            Start(upload, &budget);
+            i++;
+        }
+        else if (Finish(upload)) {
+            uploads.erase(uploads.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void TextureStreamer::Cleanup()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (Upload& upload : uploads) {
+        if (upload.fence != 0) glDeleteSync(upload.fence);
+    }
+    uploads.clear();
+
+    for (PixelBuffer& buffer : pool) glDeleteBuffers(1, &buffer.bufferID);
+    pool.clear();
+
+    if (placeholderID != 0) glDeleteTextures(1, &placeholderID);
+    placeholderID = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// textureID stays 0 until the texture is resident on the GPU
+struct StreamedTexture {
+    std::string path;
+    std::atomic<GLuint> textureID;
+
+    StreamedTexture() : textureID(0) {}
+};
+
+// Streams textures in during gameplay without stalling the render thread.
+// Decoded pixels are copied into a mapped pixel buffer object, the upload is
+// issued from it and a fence tells when the GPU is done with it.
+class TextureStreamer {
+public:
+
+    // Caps the bytes copied into pixel buffers per frame so big sheets spread over frames
+    size_t uploadBudget = 4 * 1024 * 1024;
+    int maxPixelBuffers = 4;
+
+    // Any thread
+    StreamedTexture* Request(const char* path);
+
+    // GL thread, once per frame
+    void Pump();
+    void Cleanup();
+
+private:
+
+    struct PixelBuffer {
+        GLuint bufferID = 0;
+        size_t capacity = 0;
+        bool busy = false;
+    };
+
+    struct Upload {
+        StreamedTexture* texture;
+        int loaderHandle;
+        int buffer = -1;
+        GLsync fence = 0;
+        GLuint textureID = 0;
+    };
+
+    int supported = -1;
+    // Stands in for textures that failed to load, so what uses them is still drawn
+    GLuint placeholderID = 0;
+    std::vector<PixelBuffer> pool;
+    std::vector<Upload> uploads;
+    std::vector<std::unique_ptr<StreamedTexture>> textures;
+    std::mutex mutex;
+
+    int AcquireBuffer(size_t size);
+    GLuint Placeholder();
+    bool Start(Upload& upload, size_t* budget);
+    bool Finish(Upload& upload);
+};
@@ -0,0 +1,169 @@
+#include "Trace.h"
+
+#ifdef ENGINE_TRACING
+
+#include <chrono>
+#include <cstdio>
+
+Tracer tracer;
+
+static thread_local TraceThread* currentThread = NULL;
+
+Tracer::Tracer() : capturing(false), generation(0)
+{
+    Now();
+}
+
+uint64_t Tracer::Now() const
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+TraceThread* Tracer::CurrentThread()
+{
+    // The lock is only taken the first time a thread shows up
+    if (currentThread == NULL) {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threads.push_back(std::unique_ptr<TraceThread>(new TraceThread()));
+        currentThread = threads.back().get();
+        currentThread->id = (int)threads.size();
+    }
+    return currentThread;
+}
+
+void Tracer::SetThreadName(const char* name)
+{
+    CurrentThread()->name.store(name, std::memory_order_relaxed);
+}
+
+void Tracer::Record(const TraceEvent& event)
+{
+    TraceThread* thread = CurrentThread();
+
+    // First event of a new capture, this thread drops what it had from the last one
+    uint32_t current = generation.load(std::memory_order_acquire);
+    if (thread->generation.load(std::memory_order_relaxed) != current) {
+        if (!thread->events) thread->events.reset(new TraceEvent[TRACE_EVENTS_PER_THREAD]);
+        thread->count.store(0, std::memory_order_relaxed);
+        thread->dropped.store(0, std::memory_order_relaxed);
+        thread->generation.store(current, std::memory_order_release);
+    }
+
+    uint32_t index = thread->count.load(std::memory_order_relaxed);
+    if (index >= TRACE_EVENTS_PER_THREAD) {
+        thread->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    thread->events[index] = event;
+    thread->count.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::Zone(const char* name, uint64_t start, uint64_t end)
+{
+    Record({ name, start, end - start, 0.0, false });
+}
+
+void Tracer::Counter(const char* name, double value)
+{
+    Record({ name, Now(), 0, value, true });
+}
+
+void Tracer::Capture(int frameCount, const char* path)
+{
+    if (Capturing() || frameCount <= 0) return;
+
+    this->path = path;
+    framesLeft = frameCount;
+    frameStart = Now();
+    generation.fetch_add(1, std::memory_order_release);
+    capturing.store(true, std::memory_order_release);
+    printf("Tracing %d frames to %s\n", frameCount, path);
+}
+
+void Tracer::EndFrame()
+{
+    if (Capturing() == false) return;
+
+    uint64_t now = Now();
+    Zone("frame", frameStart, now);
+    frameStart = now;
+
+    if (--framesLeft > 0) return;
+    capturing.store(false, std::memory_order_release);
+    Write();
+}
+
+static void WriteString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        if ((unsigned char)*c >= 0x20) fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Other threads may still be closing zones that began during the capture. Those
+// only ever land at or past the count read here, so the file is consistent either way.
+void Tracer::Write()
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        printf("Unable to write %s\n", path.c_str());
+        return;
+    }
+
+    std::vector<TraceThread*> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (auto& thread : threads) snapshot.push_back(thread.get());
+    }
+
+    uint32_t current = generation.load(std::memory_order_relaxed);
+    size_t written = 0;
+    uint32_t dropped = 0;
+    bool first = true;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (TraceThread* thread : snapshot) {
+        const char* name = thread->name.load(std::memory_order_relaxed);
+        if (name != NULL) {
+            fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                first ? "" : ",", thread->id);
+            WriteString(file, name);
+            fprintf(file, "}}");
+            fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                thread->id, thread->id);
+            first = false;
+        }
+
+        if (thread->generation.load(std::memory_order_acquire) != current) continue;
+        uint32_t count = thread->count.load(std::memory_order_acquire);
+        dropped += thread->dropped.load(std::memory_order_relaxed);
+
+        for (uint32_t i = 0; i < count; i++) {
+            const TraceEvent& event = thread->events[i];
+            fprintf(file, "%s\n{\"ph\":\"%s\",\"name\":", first ? "" : ",", event.counter ? "C" : "X");
+            WriteString(file, event.name);
+            if (event.counter) {
+                fprintf(file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                    thread->id, event.start / 1000.0, event.value);
+            }
+            else {
+                fprintf(file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread->id, event.start / 1000.0, event.duration / 1000.0);
+            }
+            first = false;
+        }
+        written += count;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Wrote %zu trace events to %s", written, path.c_str());
+    if (dropped > 0) printf(", %u dropped when a thread's buffer filled up", dropped);
+    printf("\n");
+}
+
+#endif
@@ -0,0 +1,112 @@
+#pragma once
+
+// Scoped zones, counters and thread names, captured for a number of frames and
+// written as Chrome trace event JSON, which chrome://tracing and ui.perfetto.dev open.
+// Only built with ENGINE_TRACING defined, otherwise every macro compiles to nothing.
+//
+//   TRACE_THREAD_NAME("render");        once at the top of a thread
+//   TRACE_SCOPE("DrawPacket");          times the enclosing block
+//   TRACE_COUNTER("sprites", count);    a value plotted over time
+//   TRACE_FRAME();                      main thread, once per frame
+//   TRACE_CAPTURE(frames, "trace.json") records the next frames and writes the file
+
+#ifdef ENGINE_TRACING
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define TRACE_EVENTS_PER_THREAD 65536
+
+struct TraceEvent {
+    const char* name;  // must outlive the capture, string literals in practice
+    uint64_t start;    // ns since the tracer started
+    uint64_t duration;
+    double value;
+    bool counter;
+};
+
+// Written only by its own thread. Events are published by bumping count with release
+// order, so the thread writing the file reads them without taking a lock.
+struct TraceThread {
+    int id = 0;
+    std::atomic<const char*> name;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> dropped;
+    std::unique_ptr<TraceEvent[]> events;
+
+    TraceThread() : name(NULL), generation(0), count(0), dropped(0) {}
+};
+
+class Tracer {
+public:
+
+    Tracer();
+
+    // Starts recording now, the file is written at the end of the last frame
+    void Capture(int frameCount, const char* path);
+    bool Capturing() const { return capturing.load(std::memory_order_relaxed); }
+
+    void SetThreadName(const char* name);
+    void Zone(const char* name, uint64_t start, uint64_t end);
+    void Counter(const char* name, double value);
+    void EndFrame();
+
+    uint64_t Now() const;
+
+private:
+
+    std::atomic<bool> capturing;
+    std::atomic<uint32_t> generation;
+    int framesLeft = 0;
+    uint64_t frameStart = 0;
+    std::string path;
+
+    std::mutex threadsMutex;
+    std::vector<std::unique_ptr<TraceThread>> threads;
+
+    TraceThread* CurrentThread();
+    void Record(const TraceEvent& event);
+    void Write();
+};
+
+extern Tracer tracer;
+
+class TraceScope {
+public:
+    TraceScope(const char* name) : name(name), active(tracer.Capturing())
+    {
+        if (active) start = tracer.Now();
+    }
+    ~TraceScope()
+    {
+        if (active) tracer.Zone(name, start, tracer.Now());
+    }
+
+private:
+    const char* name;
+    bool active;
+    uint64_t start = 0;
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_JOIN(traceScope, __LINE__)(name)
+#define TRACE_COUNTER(name, value) do { if (tracer.Capturing()) tracer.Counter(name, (double)(value)); } while (0)
+#define TRACE_THREAD_NAME(name) tracer.SetThreadName(name)
+#define TRACE_FRAME() tracer.EndFrame()
+#define TRACE_CAPTURE(frames, path) tracer.Capture(frames, path)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+#define TRACE_THREAD_NAME(name) do {} while (0)
+#define TRACE_FRAME() do {} while (0)
+#define TRACE_CAPTURE(frames, path) do {} while (0)
+
+#endif
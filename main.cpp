@@ -15,111 +15,173 @@
 #include "stb_image.h"
 
 #include "Entity.h"
-
+#include "Camera.h"
+#include "SpatialGrid.h"
+#include "Renderer.h"
+#include "TextureFile.h"
+#include "TextureCooker.h"
+#include "AssetPack.h"
+#include "TextureLoader.h"
+#include "FramePacer.h"
+#include "ParticleSystem.h"
+#include "Level.h"
+#include "LevelStreamer.h"
+#include "LevelFile.h"
+#include "LevelCompiler.h"
+#include "Benchmark.h"
+#include "Stress.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+#include "InputRecording.h"
+#include "PerfGate.h"
+#include "Hash.h"
+#include "FlightRecorder.h"
+#include "Profiler.h"
+
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
 struct GameState {
     Entity* player;
-    Entity* platform;
-    Entity* enemy1;
-    Entity* enemy2;
-    Entity* enemy3;
 };
 
 GameState state;
-int PLATFORM_COUNT = 13;
-//int ENEMY_COUNT = 3;
 GLuint fontTextureID;
 bool gameWon = false;
 bool gameOver = false;
 
 SDL_Window* displayWindow;
+SDL_GLContext glContext;
 bool gameIsRunning = true;
+bool useRenderThread = true;
 
 ShaderProgram program;
+ShaderProgram particleProgram;
 glm::mat4 viewMatrix, modelMatrix, projectionMatrix;
 
+Camera camera;
+SpatialGrid renderGrid;
+// Platforms only, queried for collision candidates around each moving entity
+SpatialGrid collisionGrid;
+LevelBuilder levelData;
+LevelFile levelFile;
+Level level;
+std::string levelPath;
+// F9 traces this many frames into tracePath, --trace starts with a capture
+int traceFrames = 300;
+bool traceAtStart = false;
+std::string tracePath = "trace.json";
+LevelStreamer levelStreamer;
+Renderer renderer;
+FramePacer framePacer;
+ParticleSystem particles;
+// --record-input keeps the player's input for every step and writes it out on exit
+const char* recordInputPath = NULL;
+InputRecording inputRecording;
+
+// Dust kicked up by a stomp, and a wider red spray when the player is caught
+const ParticleEmitter stompEmitter = { 48, PARTICLE_COLOR(245, 235, 205, 255), 3.0f, 0.5f, 1.2f, 0.6f, -9.8f };
+const ParticleEmitter hitEmitter = { 96, PARTICLE_COLOR(220, 40, 40, 255), 4.0f, 0.6f, 3.1f, 0.8f, -6.0f };
+
 GLuint LoadTexture(const char* filePath) {
-    int w, h, n;
-    unsigned char* image = stbi_load(filePath, &w, &h, &n, STBI_rgb_alpha);
+    // Usually already decoded by a worker while the window was being created
+    GLuint textureID = textureLoader.Upload(textureLoader.Request(filePath));
+
+    // Programs the driver has finished linking meanwhile are finalized now rather
+    // than on first use
+    program.IsReady();
+    particleProgram.IsReady();
+    return textureID;
+}
 
-    if (image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
+
+// The level, player and everything streamed in around it. Needs no window, replays
+// build the world with only this. Returns false if the level given couldn't be loaded.
+bool InitializeWorld() {
+    // A level file in the pack or next to the game replaces the built in layout
+    bool explicitLevel = levelPath.empty() == false;
+    bool loaded = true;
+    if (explicitLevel == false) levelPath = LEVEL_FILE_DEFAULT_NAME;
+    if (levelFile.Open(levelPath.c_str()) && levelFile.level.FindSpawn(SPAWN_PLAYER) != NULL) {
+        level = levelFile.level;
+    }
+    else {
+        if (explicitLevel) std::cout << "Unable to load level " << levelPath << ", using the built in one\n";
+        loaded = explicitLevel == false;
+        BuildDefaultLevel(&levelData);
+        levelData.Build(&level);
     }
+    const LevelSpawn* playerSpawn = level.FindSpawn(SPAWN_PLAYER);
 
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+    // Initialize player
+    state.player = new Entity();
+    state.player->entityType = PLAYER;
+    state.player->position = glm::vec3(playerSpawn->x, playerSpawn->y, 0.0f);
+    state.player->movement = glm::vec3(0);
+    state.player->acceleration = glm::vec3(1.0f, -9.81f, 0);
+    state.player->speed = playerSpawn->speed;
+    state.player->textureID = 0;
+    
+    state.player->animRight = new int[4] {3, 7, 11, 15};
+    state.player->animLeft = new int[4]{ 1, 5, 9, 13 };
+    state.player->animUp = new int[4]{ 2, 6, 10, 14 };
+    state.player->animDown = new int[4]{ 0, 4, 8, 12 };
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    state.player->animIndices = state.player->animRight;
+    state.player->animFrames = 4;
+    state.player->animIndex = 0;
+    state.player->animTime = 0;
+    state.player->animCols = 4;
+    state.player->animRows = 4;
 
-    stbi_image_free(image);
-    return textureID;
-}
+    state.player->height = playerSpawn->height;
+    state.player->width = playerSpawn->width;
+    state.player->jumpPower = playerSpawn->jumpPower;
 
-void DrawText(ShaderProgram* program, GLuint fontTextureID, std::string text,
-    float size, float spacing, glm::vec3 position)
-{
-    float width = 1.0f / 16.0f;
-    float height = 1.0f / 16.0f;
-
-    std::vector<float> vertices;
-    std::vector<float> texCoords;
-
-    for (int i = 0; i < text.size(); i++) {
-
-        int index = (int)text[i];
-        float offset = (size + spacing) * i;
-        float u = (float)(index % 16) / 16.0f;
-        float v = (float)(index / 16) / 16.0f;
-        vertices.insert(vertices.end(), {
-        offset + (-0.5f * size), 0.5f * size,
-        offset + (-0.5f * size), -0.5f * size,
-        offset + (0.5f * size), 0.5f * size,
-        offset + (0.5f * size), -0.5f * size,
-        offset + (0.5f * size), 0.5f * size,
-        offset + (-0.5f * size), -0.5f * size,
-            });
-        texCoords.insert(texCoords.end(), {
-            u, v,
-            u, v + height,
-            u + width, v,
-            u + width, v + height,
-            u + width, v,
-            u, v + height,
-            });
-
-    } // end of for loop
-
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, position);
-    program->SetModelMatrix(modelMatrix);
-
-    glUseProgram(program->programID);
-
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices.data());
-    glEnableVertexAttribArray(program->positionAttribute);
-
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords.data());
-    glEnableVertexAttribArray(program->texCoordAttribute);
-
-    glBindTexture(GL_TEXTURE_2D, fontTextureID);
-    glDrawArrays(GL_TRIANGLES, 0, (int)(text.size() * 6));
-
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+    // Platforms and enemies are created per chunk as the player gets near them
+    levelStreamer.Start(&level, &renderGrid, &collisionGrid);
+    levelStreamer.Prime(state.player->position.x);
+
+    // Everything that gets drawn goes in the render grid so Render only touches what is on screen
+    renderGrid.Insert(state.player);
+
+    camera.target = state.player;
+    camera.SetBounds(level.left, level.right, -3.75f, 3.75f);
+    camera.SnapToTarget();
+    return loaded;
 }
 
+// Undoes InitializeWorld so the next replay starts from the same state
+void ShutdownWorld() {
+    levelStreamer.Stop();
+    renderGrid.Clear();
+    collisionGrid.Clear();
+    // Fresh, so the random sequence restarts too
+    particles = ParticleSystem();
+    levelFile.Close();
+    levelData = LevelBuilder();
+
+    delete[] state.player->animRight;
+    delete[] state.player->animLeft;
+    delete[] state.player->animUp;
+    delete[] state.player->animDown;
+    delete state.player;
+    state.player = NULL;
+
+    camera = Camera();
+    gameWon = false;
+    gameOver = false;
+}
 
 void Initialize() {
     SDL_Init(SDL_INIT_VIDEO);
     displayWindow = SDL_CreateWindow("Thy-Lan Gale - Project 3", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 640, 480, SDL_WINDOW_OPENGL);
-    SDL_GLContext context = SDL_GL_CreateContext(displayWindow);
-    SDL_GL_MakeCurrent(displayWindow, context);
+    glContext = SDL_GL_CreateContext(displayWindow);
+    SDL_GL_MakeCurrent(displayWindow, glContext);
 
 #ifdef _WINDOWS
     glewInit();
@@ -127,17 +189,16 @@ void Initialize() {
 
     glViewport(0, 0, 640, 480);
 
-    program.Load("shaders/vertex_textured.glsl", "shaders/fragment_textured.glsl");
+    // Submit every program first so the driver compiles while we decode textures.
+    // LoadTexture and the renderer poll them, a program still compiling only blocks
+    // when it is first used.
+    program.BeginLoad("shaders/vertex_textured.glsl", "shaders/fragment_textured.glsl");
+    particleProgram.BeginLoad("shaders/vertex_particle.glsl", "shaders/fragment_particle.glsl");
 
     viewMatrix = glm::mat4(1.0f);
     modelMatrix = glm::mat4(1.0f);
     projectionMatrix = glm::ortho(-5.0f, 5.0f, -3.75f, 3.75f, -1.0f, 1.0f);
 
-    program.SetProjectionMatrix(projectionMatrix);
-    program.SetViewMatrix(viewMatrix);
-
-    glUseProgram(program.programID);
-
     glClearColor(0.529f, 0.808f, 0.922f, 0.0f); //background color
     glEnable(GL_BLEND);
 
@@ -147,122 +208,17 @@ void Initialize() {
     // Initialize Game Objects
     fontTextureID = LoadTexture("font1.png");
 
-    // Initialize player
-    state.player = new Entity();
-    state.player->entityType = PLAYER;
-    state.player->position = glm::vec3(-4.5f, -2.25f, 0.0f);
-    state.player->movement = glm::vec3(0);
-    state.player->acceleration = glm::vec3(1.0f, -9.81f, 0);
-    state.player->speed = 1.5f;
+    // Enemies are streamed in by the renderer and show up once the texture is resident
+    levelStreamer.tileTexture = LoadTexture("tileset.png");
+    levelStreamer.enemyTexture = renderer.streamer.Request("enemy.png");
+    InitializeWorld();
     state.player->textureID = LoadTexture("player.png");
-    
-    state.player->animRight = new int[4] {3, 7, 11, 15};
-    state.player->animLeft = new int[4]{ 1, 5, 9, 13 };
-    state.player->animUp = new int[4]{ 2, 6, 10, 14 };
-    state.player->animDown = new int[4]{ 0, 4, 8, 12 };
-
-    state.player->animIndices = state.player->animRight;
-    state.player->animFrames = 4;
-    state.player->animIndex = 0;
-    state.player->animTime = 0;
-    state.player->animCols = 4;
-    state.player->animRows = 4;
-
-    state.player->height = 0.8f;
-    state.player->width = 0.7f;
-    state.player->jumpPower = 6.0f;
-
 
-    // Initialize platform
-    state.platform = new Entity[PLATFORM_COUNT];
-    GLuint platformTextureID = LoadTexture("tileset.png");
-    
-    for (int i = 0; i < PLATFORM_COUNT - 2; i++) {
-        state.platform[i].textureID = platformTextureID;
-        state.platform[i].position = glm::vec3(-4.5 + i, -3.25f, 0.0f);
-    }
-    state.platform[10].textureID = platformTextureID;
-    state.platform[10].position = glm::vec3(-2.0f, -2.25f, 0.0f);
-
-    state.platform[11].textureID = platformTextureID;
-    state.platform[11].position = glm::vec3(2.0f, -2.25f, 0.0f);
-
-    state.platform[12].textureID = platformTextureID;
-    state.platform[12].position = glm::vec3(3.0f, -2.25f, 0.0f);
-
-    //state.platform[13].textureID = platformTextureID;
-    //state.platform[13].position = glm::vec3(4.0f, -2.25f, 0.0f);
-
-
-    for (int i = 0; i < PLATFORM_COUNT; i++) {
-        state.platform[i].entityType = PLATFORM;
-        state.platform[i].Update(0, NULL, NULL, 0);
-    }
-    /*
-    //Initialize Enemies
-    state.enemy = new Entity[ENEMY_COUNT];
-    GLuint enemyTextureID = LoadTexture("enemy.png"); //add enemy
-
-    for (int i = 0; i < ENEMY_COUNT; i++) {
-        state.enemy->entityType = ENEMY;
-        state.enemy[i].textureID = enemyTextureID;
-        state.enemy[i].acceleration = glm::vec3(0, -9.81f, 0);
-        state.enemy[i].height = 0.65f;
-        state.enemy[i].width = 0.8f;
-        state.enemy[i].speed = 1.0f;
-    }
-    state.enemy[0].position = glm::vec3(1.0f, -1.0f, 0);
-    state.enemy[0].movement = glm::vec3(-1.0f, 0, 0);
-    state.enemy[0].aiType = WALKER;
-    state.enemy[0].aiState = WALKING;
-
-    state.enemy[1].position = glm::vec3(4.0f, -1.0f, 0);
-    state.enemy[1].aiType = JUMPER;
-    state.enemy[1].aiState = JUMPING;
-    state.enemy[1].jumpPower = 3.0f;
-
-    //state.enemy[2].position = glm::vec3(2.0f, 0, 0);
-    //state.enemy[2].aiType = WAITANDGO;
-    //state.enemy[2].aiState = IDLE;
-    */
-    state.enemy1 = new Entity();
-    GLuint enemyTextureID = LoadTexture("enemy.png");
-    state.enemy1->entityType = ENEMY;
-    state.enemy1->textureID = enemyTextureID;
-    state.enemy1->acceleration = glm::vec3(0, -9.81f, 0);
-    state.enemy1->height = 0.65f;
-    state.enemy1->width = 0.8f;
-    state.enemy1->speed = 1.0f;
-    state.enemy1->position = glm::vec3(1.0f, -1.0f, 0);
-    state.enemy1->movement = glm::vec3(-1.0f, 0, 0);
-    state.enemy1->aiType = WALKER;
-    state.enemy1->aiState = WALKING;
-
-    state.enemy2 = new Entity();
-    //GLuint enemyTextureID = LoadTexture("enemy.png");
-    state.enemy2->entityType = ENEMY;
-    state.enemy2->textureID = enemyTextureID;
-    state.enemy2->acceleration = glm::vec3(0, -9.81f, 0);
-    state.enemy2->height = 0.65f;
-    state.enemy2->width = 0.8f;
-    state.enemy2->speed = 1.0f;
-    state.enemy2->position = glm::vec3(3.0f, -1.0f, 0);
-    state.enemy2->aiType = JUMPER;
-    state.enemy2->aiState = JUMPING;
-    state.enemy2->jumpPower = 3.0f;
-
-    state.enemy3 = new Entity();
-    //GLuint enemyTextureID = LoadTexture("enemy.png");
-    state.enemy3->entityType = ENEMY;
-    state.enemy3->textureID = enemyTextureID;
-    state.enemy3->acceleration = glm::vec3(0, -9.81f, 0);
-    state.enemy3->height = 0.65f;
-    state.enemy3->width = 0.8f;
-    state.enemy3->speed = 1.0f;
-    state.enemy3->position = glm::vec3(2.0f, -1.0f, 0);
-    state.enemy3->aiType = WAITANDGO;
-    state.enemy3->aiState = IDLE;
-    
+    // From here on only the renderer touches GL
+    renderer.swapInterval = framePacer.vsync;
+    if (framePacer.targetFps > 0) renderer.resolution.budget = 1000.0 / framePacer.targetFps;
+    renderer.particleProgram = &particleProgram;
+    renderer.Start(displayWindow, glContext, &program, useRenderThread);
 }
 
 void ProcessInput() {
@@ -287,6 +243,10 @@ void ProcessInput() {
                 // Move the player right
                 break;
 
+            case SDLK_F9:
+                TRACE_CAPTURE(traceFrames, tracePath.c_str());
+                break;
+
             case SDLK_SPACE:
                 // Some sort of action
                 if (state.player->collidedBottom) {
@@ -319,12 +279,111 @@ void ProcessInput() {
         state.player->movement = glm::normalize(state.player->movement);
     }
 
+    if (keys[SDL_SCANCODE_EQUALS]) {
+        camera.SetZoom(camera.zoom * 1.02f);
+    }
+    else if (keys[SDL_SCANCODE_MINUS]) {
+        camera.SetZoom(camera.zoom / 1.02f);
+    }
+
 }
 
 #define FIXED_TIMESTEP 0.0166666f
+
+// Collides against nearby platforms only, the grid hands back a handful instead of the whole level
+void UpdateEntity(Entity* entity) {
+    if (entity->isActive == false) return;
+
+    // Only needed for this one update
+    FrameArena& arena = FrameArena::ForThread();
+    FrameArenaScope scope(arena);
+    FrameVector<Entity*> collisionCandidates{FrameAllocator<Entity*>(&arena)};
+    collisionCandidates.reserve(64);
+
+    float margin = 1.0f;
+    {
+        ProfilePhaseScope phase(PROFILE_COLLISION);
+        collisionGrid.Query(entity->position.x - entity->width / 2.0f - margin, entity->position.y - entity->height / 2.0f - margin,
+            entity->position.x + entity->width / 2.0f + margin, entity->position.y + entity->height / 2.0f + margin, collisionCandidates);
+    }
+
+    entity->Update(FIXED_TIMESTEP, state.player, collisionCandidates.data(), (int)collisionCandidates.size());
+}
+
+// The player's input for a step as --record-input stores it
+uint8_t CurrentInput() {
+    uint8_t input = 0;
+    if (state.player->movement.x < 0) input |= INPUT_LEFT;
+    if (state.player->movement.x > 0) input |= INPUT_RIGHT;
+    if (state.player->jump) input |= INPUT_JUMP;
+    return input;
+}
+
+// What ProcessInput would have done for a recorded step. Jump is only ever set, the
+// player clears it once it has jumped.
+void ApplyInput(uint8_t input) {
+    state.player->movement = glm::vec3(0);
+    if (input & INPUT_LEFT) {
+        state.player->movement.x = -1.0f;
+        state.player->animIndices = state.player->animLeft;
+    }
+    else if (input & INPUT_RIGHT) {
+        state.player->movement.x = 1.0f;
+        state.player->animIndices = state.player->animRight;
+    }
+    if (input & INPUT_JUMP) state.player->jump = true;
+}
+
+// One fixed step of the simulation
+void Step() {
+    // The player moves first so enemies react to where it is this step
+    UpdateEntity(state.player);
+    for (Entity* enemy : levelStreamer.enemies) {
+        UpdateEntity(enemy);
+    }
+    camera.Update(FIXED_TIMESTEP);
+    particles.Update(FIXED_TIMESTEP);
+}
+
+// Once per frame after the steps
+void ApplyRules() {
+    renderGrid.Update(state.player);
+    for (Entity* enemy : levelStreamer.enemies) {
+        renderGrid.Update(enemy);
+    }
+
+
+    //Checking for Collisions for winning and losing
+    
+    for (Entity* enemy : levelStreamer.enemies) {
+        // Walkers push the player back sideways and hurt on any contact, the others only from the side
+        bool walker = enemy->aiType == WALKER;
+        enemy->CheckCollisionsY(&state.player, 1);
+        if (walker) enemy->CheckCollisionsX(&state.player, 1);
+
+        if (enemy->lastCollision == state.player && enemy->collidedTop) {
+            if (enemy->isActive) {
+                particles.Burst(stompEmitter, enemy->position);
+                levelStreamer.MarkDefeated(enemy);
+            }
+            enemy->isActive = false;
+        }
+
+        else if (enemy->lastCollision == state.player && enemy->isActive == true && (walker || enemy->collidedLeft || enemy->collidedRight)) {
+            if (gameOver == false) particles.Burst(hitEmitter, state.player->position);
+            gameOver = true;
+        }
+    }
+
+    if (levelStreamer.AllEnemiesDefeated()) {
+        gameWon = true;
+    }
+}
+
 float lastTicks = 0;
 float accumulator = 0.0f;
-void Update() {
+// Returns how many fixed steps ran
+int Update() {
     float ticks = (float)SDL_GetTicks() / 1000.0f;
     float deltaTime = ticks - lastTicks;
     lastTicks = ticks;
@@ -332,138 +391,351 @@ void Update() {
     deltaTime += accumulator;
     if (deltaTime < FIXED_TIMESTEP) {
         accumulator = deltaTime;
-        return;
+        return 0;
     }
 
+    levelStreamer.Update(state.player->position.x);
+
+    int steps = 0;
     while (deltaTime >= FIXED_TIMESTEP) {
+        TRACE_SCOPE("step");
+        ProfilePhaseScope phase(PROFILE_FIXED_STEP);
+        steps++;
+        if (recordInputPath != NULL) inputRecording.steps.push_back(CurrentInput());
         // Update. Notice it's FIXED_TIMESTEP. Not deltaTime
-        state.player->Update(FIXED_TIMESTEP, state.player, state.platform, PLATFORM_COUNT);
-        state.enemy1->Update(FIXED_TIMESTEP, state.player, state.platform, PLATFORM_COUNT);
-        state.enemy2->Update(FIXED_TIMESTEP, state.player, state.platform, PLATFORM_COUNT);
-        state.enemy3->Update(FIXED_TIMESTEP, state.player, state.platform, PLATFORM_COUNT);
-        //for (int i = 0; i < ENEMY_COUNT; i++) {
-            //state.enemy[i].Update(FIXED_TIMESTEP, state.player, state.platform, PLATFORM_COUNT);
-        //}
+        Step();
         deltaTime -= FIXED_TIMESTEP;
     }
 
     accumulator = deltaTime;
+    metrics.Add(METRIC_FIXED_STEPS, steps);
+    if (recordInputPath != NULL) inputRecording.steps.back() |= INPUT_FRAME_END;
 
+    TRACE_SCOPE("rules");
+    ProfilePhaseScope phase(PROFILE_RULES);
+    ApplyRules();
+    return steps;
+}
 
-    //Checking for Collisions for winning and losing
-    
-    state.enemy1->CheckCollisionsY(state.player, 1);
-    state.enemy1->CheckCollisionsX(state.player, 1);
 
-    state.enemy2->CheckCollisionsY(state.player, 1);
-    //state.enemy2->CheckCollisionsX(state.player, 1);
+// Everything on screen this frame, Render hands it to the render thread
+void BuildPacket(RenderPacket* packet) {
+    packet->projectionMatrix = camera.projectionMatrix;
+    packet->viewMatrix = camera.viewMatrix;
 
-    state.enemy3->CheckCollisionsY(state.player, 1);
-    //state.enemy3->CheckCollisionsX(state.player, 1);
-    
-    if (state.enemy1->lastCollision == state.player && state.enemy1->collidedTop) {
-        state.enemy1->isActive = false;
-    }
-    
-    else if (state.enemy1->lastCollision == state.player && state.enemy1->isActive == true) gameOver = true;
+    float left, bottom, right, top;
+    camera.GetVisibleRect(&left, &bottom, &right, &top);
 
-    if (state.enemy2->lastCollision == state.player && state.enemy2->collidedTop) {
-        state.enemy2->isActive = false;
+    FrameVector<Entity*> visibleEntities{FrameAllocator<Entity*>(&FrameArena::ForThread())};
+    visibleEntities.reserve(256);
+    renderGrid.Query(left, bottom, right, top, visibleEntities);
+    for (Entity* entity : visibleEntities) {
+        entity->Render(packet);
     }
+    TRACE_COUNTER("visible entities", visibleEntities.size());
+    metrics.Add(METRIC_SPRITES_SUBMITTED, packet->tiles.size() + packet->sprites.size());
+    particles.Render(packet);
 
-    else if (state.enemy2->lastCollision == state.player && state.enemy2->isActive == true && (state.enemy2->collidedLeft || state.enemy2->collidedRight)) gameOver = true;
+    //Text is drawn in screen space, on top of the world
+    packet->hudProjectionMatrix = projectionMatrix;
+    packet->hudViewMatrix = viewMatrix;
 
-    if (state.enemy3->lastCollision == state.player && state.enemy3->collidedTop) {
-        state.enemy3->isActive = false;
+    //Print outcome
+    if (gameWon) { //print mission successful
+        packet->texts.push_back({ fontTextureID, "You Won!", 0.5f, -0.25f, glm::vec3(-1.0f, 3.3, 0) });
     }
-
-    else if (state.enemy3->lastCollision == state.player && state.enemy3->isActive == true && (state.enemy3->collidedLeft || state.enemy3->collidedRight)) gameOver = true;
-
-
-    if (state.enemy1->isActive == false && state.enemy2->isActive == false && state.enemy3->isActive == false) {
-        gameWon = true;
+    else if (gameOver) { //print mission failed
+        packet->texts.push_back({ fontTextureID, "Game Over", 0.5f, -0.25f, glm::vec3(-1.5f, 3.3, 0) });
     }
-    
 }
 
-
 void Render() {
-    glClear(GL_COLOR_BUFFER_BIT);
+    RenderPacket* packet = renderer.BeginPacket();
+    BuildPacket(packet);
 
-    state.player->Render(&program);
-    for (int i = 0; i < PLATFORM_COUNT; i++) {
-        state.platform[i].Render(&program);
-    }
-    state.enemy1->Render(&program);
-    state.enemy2->Render(&program);
-    state.enemy3->Render(&program);
-    //for (int i = 0; i < ENEMY_COUNT; i++) {
-        //state.enemy[i].Render(&program);
-    //}
-
-    //Checking for Collisions for winning and losing
-    /*
-    state.enemy1->CheckCollisionsY(state.player, 1);
-    state.enemy1->CheckCollisionsX(state.player, 1);
-    
-    state.player->CheckCollisionsY(state.enemy2, 1);
-    state.player->CheckCollisionsX(state.enemy2, 1);
-    
-    state.player->CheckCollisionsY(state.enemy3, 1);
-    state.player->CheckCollisionsX(state.enemy3, 1);
-
-    if (state.enemy1->collidedTop && state.enemy1->lastCollision == state.player) state.enemy1->isActive = false;
-    */
-    /*
-    if (state.player->collidedBottom && state.player->lastCollision == state.enemy1) {
-        state.enemy1->isActive = false;
-    }
-    else if (state.player->lastCollision == state.enemy1 &&(state.player->collidedLeft || state.player->collidedRight)) gameOver = true;
-    if (state.player->collidedBottom && state.player->lastCollision == state.enemy2) {
-        state.enemy2->isActive = false;
-    }
-    else if (state.player->lastCollision == state.enemy2 && (state.player->collidedLeft || state.player->collidedRight)) gameOver = true;
-    if (state.player->collidedBottom && state.player->lastCollision == state.enemy3) {
-        state.enemy3->isActive = false;
-    }
-    else if (state.player->lastCollision == state.enemy3 && (state.player->collidedLeft || state.player->collidedRight)) gameOver = true;
-    
+    // Drawn by the render thread while we simulate the next frame
+    renderer.SubmitPacket();
+}
 
-    if (state.enemy1->isActive == false && state.enemy2->isActive == false && state.enemy3->isActive == false) {
-        gameWon = true;
-    }
-    */
 
+// Everything the simulation decides, a replay that desyncs changes it
+uint64_t WorldChecksum() {
+    uint64_t hash = HashBytes(&gameWon, sizeof(gameWon));
+    hash = HashBytes(&gameOver, sizeof(gameOver), hash);
+    int particleCount = particles.Count();
+    hash = HashBytes(&particleCount, sizeof(particleCount), hash);
+
+    auto add = [&](const Entity* entity) {
+        hash = HashBytes(&entity->position, sizeof(entity->position), hash);
+        hash = HashBytes(&entity->velocity, sizeof(entity->velocity), hash);
+        if (entity->entityType == ENEMY) hash = HashBytes(&entity->aiState, sizeof(entity->aiState), hash);
+        hash = HashBytes(&entity->isActive, sizeof(entity->isActive), hash);
+    };
+    add(state.player);
+    for (Entity* enemy : levelStreamer.enemies) add(enemy);
+    return hash;
+}
 
-    
+// --perf-gate runs sessions through here, the same steps and rules as Update with
+// frames cut where they were recorded. Streaming is primed instead of left to the
+// worker so chunks arrive on the same frame every run.
+bool ReplaySession(const InputRecording& recording, ReplayResult* result) {
+    levelPath = recording.level;
+    bool loaded = InitializeWorld();
+
+    RenderPacket packet;
+    size_t step = 0;
+    int frames = 0;
+    while (step < recording.steps.size()) {
+        double start = FrameStats::Now();
+        levelStreamer.Prime(state.player->position.x);
+
+        // The frame's work, which --alloc-assert checks for allocations. Streaming is left
+        // out, bringing a chunk in allocates by design.
+        double simulated, ruled, submitted, end;
+        {
+            ALLOC_FRAME_SCOPE();
+            simulated = FrameStats::Now();
+            bool frameEnd = false;
+            while (step < recording.steps.size() && frameEnd == false) {
+                uint8_t input = recording.steps[step++];
+                ApplyInput(input);
+                Step();
+                frameEnd = (input & INPUT_FRAME_END) != 0;
+            }
 
+            ruled = FrameStats::Now();
+            ApplyRules();
 
-    //Print outcome
-    if (gameWon) { //print mission successful
-        DrawText(&program, fontTextureID, "You Won!", 0.5f, -0.25f, glm::vec3(-1.0f, 3.3, 0));
-    }
-    else if (gameOver) { //print mission failed
-        DrawText(&program, fontTextureID, "Game Over", 0.5f, -0.25f, glm::vec3(-1.5f, 3.3, 0));
+            submitted = FrameStats::Now();
+            packet.Clear();
+            BuildPacket(&packet);
+            FrameArena::ForThread().Reset();
+            end = FrameStats::Now();
+        }
+        result->phases[REPLAY_STREAMING].push_back(simulated - start);
+        result->phases[REPLAY_SIMULATION].push_back(ruled - simulated);
+        result->phases[REPLAY_RULES].push_back(submitted - ruled);
+        result->phases[REPLAY_SUBMIT].push_back(end - submitted);
+
+        frames++;
+        if (frames % REPLAY_BLOCK_FRAMES == 0 || step == recording.steps.size()) {
+            result->checksums.push_back(WorldChecksum());
+        }
     }
 
+    ShutdownWorld();
+    return loaded;
+}
 
-    SDL_GL_SwapWindow(displayWindow);
+// Keeps the frame that just ended, and snapshots the world if it was a spike
+void RecordFlight(int steps, uint8_t input) {
+    FlightFrame frame;
+    frame.row = metrics.LastRow();
+    frameStats.LastFrame(frame.phases);
+    frame.steps = steps;
+    frame.input = input;
+    frame.playerX = state.player->position.x;
+    frame.playerY = state.player->position.y;
+
+    FlightSnapshot* snapshot = flightRecorder.Record(frame);
+    if (snapshot == NULL) return;
+
+    snapshot->gameWon = gameWon;
+    snapshot->gameOver = gameOver;
+    snapshot->cameraX = camera.position.x;
+    snapshot->cameraY = camera.position.y;
+    snapshot->zoom = camera.zoom;
+    snapshot->activeChunks = levelStreamer.ActiveChunkCount();
+    snapshot->particles = particles.Count();
+
+    auto add = [&](const Entity* entity) {
+        bool enemy = entity->entityType == ENEMY;
+        snapshot->Add({ (uint8_t)entity->entityType, (uint8_t)(enemy ? entity->aiType : 0), (uint8_t)(enemy ? entity->aiState : 0),
+            entity->isActive, entity->position.x, entity->position.y, entity->velocity.x, entity->velocity.y });
+    };
+    add(state.player);
+    for (Entity* enemy : levelStreamer.enemies) add(enemy);
 }
 
+// Next to the executable unless --pack says otherwise, so the working directory doesn't matter
+void OpenAssetPack(std::string packPath) {
+    if (packPath.empty()) {
+        char* basePath = SDL_GetBasePath();
+        if (basePath != NULL) {
+            packPath = std::string(basePath) + ASSET_PACK_DEFAULT_NAME;
+            SDL_free(basePath);
+        }
+    }
+    if (packPath.empty() == false) assetPack.Open(packPath.c_str());
+}
 
 void Shutdown() {
+    renderer.Stop();
+    flightRecorder.Stop();
+    levelStreamer.Stop();
+    levelFile.Close();
+    metrics.Close();
+    textureLoader.Stop();
+    // While the GL driver is still loaded, so its frames can be named
+    profiler.Stop();
     SDL_Quit();
 }
 
 int main(int argc, char* argv[]) {
-    Initialize();
+    frameStats.MarkStart();
+
+    // Offline tools, these never open a window
+    if (argc > 1 && strcmp(argv[1], "--cook-textures") == 0) return CookTextures(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--pack-assets") == 0) return PackAssets(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--export-level") == 0) return ExportLevel(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--compile-level") == 0) return CompileLevel(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return RunBenchmarks(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--stress") == 0) return RunStress(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--metrics-watch") == 0) return WatchMetrics(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--perf-gate") == 0) {
+        // Levels come from the pack, same as in the game
+        OpenAssetPack("");
+        return RunPerfGate(argc - 2, argv + 2, ReplaySession);
+    }
+
+    std::string packPath;
+    const char* metricsCsvPath = NULL;
+    const char* metricsShmName = NULL;
+    int metricsCsvRows = 36000;
+    bool allocationReport = false;
+    // A frame that needs more than three fixed steps to catch up is a hitch worth keeping
+    flightRecorder.spikeMilliseconds = FIXED_TIMESTEP * 3 * 1000.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-render-thread") == 0) useRenderThread = false;
+        else if (strcmp(argv[i], "--stats") == 0) frameStats.printEnabled = true;
+        else if (strcmp(argv[i], "--counters") == 0) {
+            // CPU counters per phase, printed under the timings
+            HardwareCounters::enabled = true;
+            frameStats.printEnabled = true;
+        }
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) packPath = argv[++i];
+        else if (strcmp(argv[i], "--verify-pack") == 0) assetPack.verifyHashes = true;
+        else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) levelPath = argv[++i];
+        else if (strcmp(argv[i], "--record-input") == 0 && i + 1 < argc) recordInputPath = argv[++i];
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceFrames = atoi(argv[++i]);
+            traceAtStart = true;
+        }
+        else if (strcmp(argv[i], "--trace-out") == 0 && i + 1 < argc) tracePath = argv[++i];
+        else if (strcmp(argv[i], "--metrics-csv") == 0 && i + 1 < argc) metricsCsvPath = argv[++i];
+        else if (strcmp(argv[i], "--metrics-csv-rows") == 0 && i + 1 < argc) metricsCsvRows = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--metrics-shm") == 0 && i + 1 < argc) metricsShmName = argv[++i];
+        else if (strcmp(argv[i], "--no-flight-recorder") == 0) flightRecorder.enabled = false;
+        else if (strcmp(argv[i], "--spike-ms") == 0 && i + 1 < argc) flightRecorder.spikeMilliseconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--flight-dir") == 0 && i + 1 < argc) flightRecorder.directory = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0) profiler.enabled = true;
+        else if (strcmp(argv[i], "--profile-out") == 0 && i + 1 < argc) profiler.path = argv[++i];
+        else if (strcmp(argv[i], "--profile-hz") == 0 && i + 1 < argc) profiler.frequency = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--alloc-report") == 0) allocationReport = true;
+        else if (strcmp(argv[i], "--alloc-assert") == 0) {
+            // Complains about every allocation a frame makes once the game has warmed up
+#ifdef ENGINE_ALLOC_TRACKING
+            allocationTracker.assertInFrame = true;
+#endif
+            allocationReport = true;
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) framePacer.targetFps = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--no-skip-render") == 0) framePacer.skipIdleFrames = false;
+        else if (strcmp(argv[i], "--no-dynamic-resolution") == 0) renderer.resolution.enabled = false;
+        else if (strcmp(argv[i], "--resolution-scale") == 0 && i + 1 < argc) {
+            // A fixed scale, mostly for checking how the upscale looks
+            renderer.resolution.enabled = false;
+            renderer.resolution.scale = glm::clamp((float)atof(argv[++i]), 0.1f, 1.0f);
+        }
+        else if (strcmp(argv[i], "--vsync") == 0 && i + 1 < argc) {
+            if (FramePacer::ParseVsync(argv[++i], &framePacer.vsync) == false) {
+                std::cout << "--vsync takes off, on or adaptive\n";
+                return 1;
+            }
+        }
+    }
+
+    OpenAssetPack(packPath);
+
+    // Before the first thread starts, each one registers itself
+    profiler.Start();
+    profiler.RegisterThread("main");
+
+    // Per frame counters, rolled over every metricsCsvRows frames or published for --metrics-watch
+    if (metricsCsvPath != NULL) metrics.OpenCsv(metricsCsvPath, metricsCsvRows);
+    if (metricsShmName != NULL) metrics.OpenSharedMemory(metricsShmName);
+
+    // Decode every texture Initialize needs while SDL and GL start up
+    textureLoader.Start();
+    textureLoader.Request("font1.png");
+    textureLoader.Request("player.png");
+    textureLoader.Request("tileset.png");
+    textureLoader.Request("enemy.png");
+
+    // Kept as given, a replay falls back to the default level the same way
+    inputRecording.level = levelPath;
+    // An hour of steps, so recording doesn't allocate during frames
+    if (recordInputPath != NULL) inputRecording.steps.reserve(60 * 60 * 60);
+
+    TRACE_THREAD_NAME("main");
+    {
+        ALLOC_TAG("initialize");
+        Initialize();
+        flightRecorder.Start();
+    }
+
+#ifdef ENGINE_TRACING
+    if (traceAtStart) TRACE_CAPTURE(traceFrames, tracePath.c_str());
+#else
+    if (traceAtStart) std::cout << "Built without ENGINE_TRACING, --trace does nothing\n";
+#endif
+#ifndef ENGINE_ALLOC_TRACKING
+    if (allocationReport) std::cout << "Built without ENGINE_ALLOC_TRACKING, allocations are not counted\n";
+#endif
 
     while (gameIsRunning) {
-        ProcessInput();
-        Update();
-        Render();
+        ALLOC_FRAME_SCOPE();
+        {
+            StatScope timer(STAT_INPUT);
+            TRACE_SCOPE("ProcessInput");
+            ProfilePhaseScope phase(PROFILE_INPUT);
+            ProcessInput();
+        }
+        uint8_t input = CurrentInput();
+        int steps;
+        {
+            StatScope timer(STAT_UPDATE);
+            TRACE_SCOPE("Update");
+            ProfilePhaseScope phase(PROFILE_UPDATE);
+            steps = Update();
+        }
+        // Nothing moved, the frame on screen is still current
+        if (steps > 0 || framePacer.skipIdleFrames == false) {
+            StatScope timer(STAT_RENDER_SUBMIT);
+            TRACE_SCOPE("Render");
+            ProfilePhaseScope phase(PROFILE_RENDER_SUBMIT);
+            Render();
+        }
+        frameStats.EndFrame();
+#ifdef ENGINE_ALLOC_TRACKING
+        allocationTracker.EndFrame();
+#endif
+        metrics.EndFrame();
+        RecordFlight(steps, input);
+        // Whatever this frame put in the arena is done with
+        FrameArena::ForThread().Reset();
+        framePacer.Wait();
+        TRACE_FRAME();
     }
 
     Shutdown();
+    if (recordInputPath != NULL) {
+        if (inputRecording.Write(recordInputPath)) std::cout << "Recorded " << inputRecording.steps.size() << " steps to " << recordInputPath << "\n";
+        else std::cout << "Unable to write " << recordInputPath << "\n";
+    }
+#ifdef ENGINE_ALLOC_TRACKING
+    if (allocationReport) allocationTracker.Report();
+#endif
     return 0;
 }
\ No newline at end of file
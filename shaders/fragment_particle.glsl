@@ -0,0 +1,5 @@
+varying vec4 colorVar;
+
+void main() {
+    gl_FragColor = colorVar;
+}
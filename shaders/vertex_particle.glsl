@@ -0,0 +1,16 @@
+attribute float positionX;
+attribute float positionY;
+attribute float life;
+attribute vec4 color;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+varying vec4 colorVar;
+
+void main()
+{
+    colorVar = vec4(color.rgb, color.a * life);
+	gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(positionX, positionY, 0.0, 1.0);
+}